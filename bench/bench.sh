@@ -0,0 +1,129 @@
+#!/bin/sh
+#
+# fittsmon : headless end-to-end benchmark, run by `make bench`.
+#
+# Starts Xvfb with BENCH_MONITORS side by side RandR monitors, runs
+# fittsmon on all of them against a generated fittsmonrc and drives every
+# zone with XTEST (see xdrive.c). Reports startup time, events/s, dispatch
+# latency, memory use and the CPU time the X server and fittsmon spent.
+#
+#   BENCH_MONITORS  monitors to create (default 2)
+#   BENCH_ROUNDS    visits of every zone (default 200)
+#   BENCH_WHEEL     wheel clicks up and down per visit (default 8)
+#   BENCH_MODE      windows or windowless (default windows)
+#
+
+set -u
+
+here=$(cd "$(dirname "$0")" && pwd)
+fittsmon=$here/../fittsmon
+xdrive=$here/xdrive
+
+monitors=${BENCH_MONITORS:-2}
+rounds=${BENCH_ROUNDS:-200}
+wheel=${BENCH_WHEEL:-8}
+mode=${BENCH_MODE:-windows}
+width=1920
+height=1080
+
+for tool in Xvfb xrandr; do
+  command -v $tool >/dev/null 2>&1 || { echo "bench: $tool is required" >&2; exit 1; }
+done
+
+work=$(mktemp -d)
+xvfb_pid=
+fittsmon_pid=
+
+cleanup () {
+  [ -n "$fittsmon_pid" ] && kill $fittsmon_pid 2>/dev/null
+  [ -n "$xvfb_pid" ] && kill $xvfb_pid 2>/dev/null
+  wait 2>/dev/null
+  rm -rf "$work"
+}
+trap cleanup EXIT INT TERM
+
+now_ms () {
+  date +%s%3N
+}
+
+# User plus system CPU time of a process, in ms
+cpu_ms () {
+  awk -v hz=$(getconf CLK_TCK) '{ sub(/.*\) /, ""); print int(($12 + $13) * 1000 / hz) }' /proc/$1/stat
+}
+
+case $mode in
+  windows) mode_flag= ;;
+  windowless) mode_flag=--windowless ;;
+  *) echo "bench: BENCH_MODE is windows or windowless" >&2; exit 1 ;;
+esac
+
+# X server
+
+display=90
+while [ -e /tmp/.X11-unix/X$display ] || [ -e /tmp/.X$display-lock ]; do
+  display=$((display + 1))
+done
+
+Xvfb :$display -screen 0 $((width * monitors))x${height}x24 -nolisten tcp \
+  +extension RANDR +extension XTEST >"$work/xvfb.log" 2>&1 &
+xvfb_pid=$!
+export DISPLAY=:$display
+
+tries=0
+until xrandr --listmonitors >/dev/null 2>&1; do
+  tries=$((tries + 1))
+  [ $tries -gt 200 ] && { echo "bench: Xvfb did not start" >&2; cat "$work/xvfb.log" >&2; exit 1; }
+  sleep 0.05
+done
+
+# Split the screen into monitors. The first one takes over Xvfb's only
+# output, which hides the monitor RandR makes up for it.
+output=$(xrandr | awk '/ connected/ { print $1; exit }')
+names=
+i=0
+while [ $i -lt $monitors ]; do
+  [ $i -eq 0 ] && owner=$output || owner=none
+  xrandr --setmonitor bench-$i ${width}/508x${height}/286+$((i * width))+0 $owner || exit 1
+  names="$names bench-$i"
+  i=$((i + 1))
+done
+
+# Configuration: every zone spawns a trivial command, wheel down bursts
+# are coalesced
+
+export XDG_CONFIG_HOME="$work/config"
+export XDG_RUNTIME_DIR="$work"
+mkdir -p "$XDG_CONFIG_HOME/fittsmon"
+for position in TopLeft TopCenter TopRight Right BottomRight BottomCenter BottomLeft Left; do
+  printf '[%s]\nLeftButton=true\nWheelUp=true\nWheelDown=true\nWheelDown.Coalesce=20\n\n' $position
+done >"$XDG_CONFIG_HOME/fittsmon/fittsmonrc"
+
+# fittsmon: up once it answers on its socket
+
+start=$(now_ms)
+"$fittsmon" $mode_flag --monitor $names >"$work/fittsmon.log" 2>&1 &
+fittsmon_pid=$!
+
+until "$fittsmon" --stats >/dev/null 2>&1; do
+  kill -0 $fittsmon_pid 2>/dev/null || { echo "bench: fittsmon exited" >&2; cat "$work/fittsmon.log" >&2; exit 1; }
+  sleep 0.01
+done
+startup=$(($(now_ms) - start))
+
+# Load
+
+echo "fittsmon bench: $mode, $monitors monitors, $rounds rounds, $wheel wheel clicks per visit"
+echo "startup        $startup ms"
+xvfb_cpu=$(cpu_ms $xvfb_pid)
+fittsmon_cpu=$(cpu_ms $fittsmon_pid)
+"$xdrive" $rounds $wheel "$XDG_RUNTIME_DIR/fittsmon.sock"
+status=$?
+echo "X server CPU   $(($(cpu_ms $xvfb_pid) - xvfb_cpu)) ms"
+echo "fittsmon CPU   $(($(cpu_ms $fittsmon_pid) - fittsmon_cpu)) ms"
+
+awk '/^VmRSS|^VmHWM/ { printf "%-14s %s %s\n", $1, $2, $3 }' /proc/$fittsmon_pid/status
+
+# fittsmon's own view: the latency summary lines of the report
+"$fittsmon" --stats | grep -e ' -> ' -e '^Launch queue'
+
+exit $status
@@ -0,0 +1,343 @@
+/**************************************************************************
+*
+* fittsmon : map mouse button events on screen corners to commands.
+*             Benchmark driver: injects input into the zones with XTEST.
+*
+* Copyright (C) 2009 Yasen Atanasov (yasen.atanasov@gmail.com)
+* Modified 2025 by Eric Bakker (linuxbirdtweets@duck.com)
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License version 2
+* as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**************************************************************************/
+
+/*
+ * Run by bench.sh against a fittsmon on a headless server:
+ *
+ *     xdrive <rounds> <wheel clicks> <broadcast socket>
+ *
+ * The zones are asked from fittsmon over its socket, so the driver
+ * follows whatever layout fittsmon uses, with or without zone windows.
+ * Each round visits every zone: the pointer warps in and, once fittsmon
+ * has dispatched Enter, clicks button 1 and scrolls up and down, then
+ * warps back to a spot outside every zone (Leave). Waiting for Enter
+ * matters without zone windows: fittsmon only grabs the buttons once it
+ * knows the pointer is in a zone.
+ *
+ * What fittsmon dispatched is read back from the event broadcast socket
+ * while injecting. The time from injecting a warp or a click to its
+ * Enter or LeftButton line is the end-to-end dispatch latency; inputs and
+ * lines are matched in order.
+ */
+
+
+/* INCLUDES */
+
+#include <xcb/xcb.h>
+#include <xcb/xtest.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+
+/* CONSTANTS/OPTIONS */
+
+#define MAX_ZONES 1024
+
+/* Give up on lines that have not arrived this long after the last one */
+#define IDLE_TIMEOUT_MS 2000
+
+/* STRUCTS */
+
+struct str_zone {
+  int x;
+  int y;
+  int w;
+  int h;
+};
+
+/* Inputs whose dispatch is timed */
+struct str_probe {
+  const char *event;   /* event name in the broadcast line, with the blanks around it */
+  long long *sent;     /* ns each input was injected at */
+  long long *latency;  /* ns from input to its line */
+  int sent_count;
+  int seen;
+};
+
+/* GLOBALS */
+
+static xcb_connection_t *connection;
+static xcb_window_t root;
+
+static int sock = -1;
+static char line_buf[4096];
+static size_t line_len = 0;
+static long long lines = 0;
+static long long last_line = 0;  /* ns the newest line arrived at */
+
+static struct str_probe enters = { .event = " Enter " };
+static struct str_probe clicks = { .event = " LeftButton " };
+
+/* implementations */
+
+static long long
+now_ns (void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int
+connect_socket (const char *path, int flags)
+{
+  struct sockaddr_un addr;
+  int fd;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+  fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | flags, 0);
+  if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    fprintf(stderr, "xdrive: cannot connect to %s: %s\n", path, strerror(errno));
+    if (fd >= 0) close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/* The zone rectangles, as the running fittsmon reports them */
+static int
+find_zones (const char *path, struct str_zone *zones)
+{
+  int fd = connect_socket(path, 0);
+  int count = 0;
+  FILE *in;
+
+  if (fd < 0) return 0;
+  if (send(fd, "zones\n", 6, MSG_NOSIGNAL) != 6 || !(in = fdopen(fd, "r"))) {
+    close(fd);
+    return 0;
+  }
+
+  /* <monitor>-<zone> <x> <y> <width> <height> */
+  while (count < MAX_ZONES && fscanf(in, "%*s %d %d %d %d", &zones[count].x, &zones[count].y,
+                                     &zones[count].w, &zones[count].h) == 4) {
+    count++;
+  }
+  fclose(in);
+  return count;
+}
+
+/* A point on the screen outside every zone, for the pointer to leave to */
+static void
+find_park (const struct str_zone *zones, int count, int width, int height, int *px, int *py)
+{
+  for (int i = 1; i < 8; i++) {
+    for (int j = 1; j < 8; j++) {
+      int x = width * i / 8, y = height * j / 8, z;
+
+      for (z = 0; z < count; z++) {
+        if (x >= zones[z].x && x < zones[z].x + zones[z].w && y >= zones[z].y && y < zones[z].y + zones[z].h) break;
+      }
+      if (z == count) {
+        *px = x;
+        *py = y;
+        return;
+      }
+    }
+  }
+  *px = width / 3;
+  *py = height / 3;
+}
+
+static void
+inject (uint8_t type, uint8_t detail, int x, int y)
+{
+  xcb_test_fake_input(connection, type, detail, XCB_CURRENT_TIME, root, x, y, 0);
+}
+
+static int
+compare_ll (const void *a, const void *b)
+{
+  long long x = *(const long long *)a, y = *(const long long *)b;
+
+  return x < y ? -1 : x > y;
+}
+
+static int
+probe_init (struct str_probe *probe, size_t count)
+{
+  probe->sent = calloc(count, sizeof(long long));
+  probe->latency = calloc(count, sizeof(long long));
+  return probe->sent && probe->latency ? 0 : -1;
+}
+
+/* Match a broadcast line, <zone> <event> <monitor> <time> <count>, to
+   the oldest input of the probe still waiting for one */
+static void
+probe_line (struct str_probe *probe, const char *line, long long now)
+{
+  if (probe->seen < probe->sent_count && strstr(line, probe->event)) {
+    probe->latency[probe->seen] = now - probe->sent[probe->seen];
+    probe->seen++;
+  }
+}
+
+static void
+probe_report (struct str_probe *probe, const char *label)
+{
+  if (!probe->seen) return;
+
+  qsort(probe->latency, probe->seen, sizeof(long long), compare_ll);
+  printf("%-14s p50 %.1f us, p99 %.1f us (inject -> dispatch, %d samples)\n", label,
+         probe->latency[probe->seen / 2] / 1e3, probe->latency[probe->seen * 99 / 100] / 1e3, probe->seen);
+}
+
+/* Read what fittsmon has sent, waiting up to timeout ms for it.
+   Returns 0 once the socket is idle for that long. */
+static int
+drain (int timeout)
+{
+  struct pollfd pfd = { .fd = sock, .events = POLLIN };
+  int got = 0;
+
+  while (poll(&pfd, 1, got ? 0 : timeout) > 0) {
+    ssize_t n = recv(sock, line_buf + line_len, sizeof(line_buf) - line_len, 0);
+    long long now = now_ns();
+    char *start = line_buf, *end;
+
+    if (n <= 0) return 0;
+    line_len += n;
+    got = 1;
+
+    while ((end = memchr(start, '\n', line_buf + line_len - start))) {
+      lines++;
+      last_line = now;
+      *end = '\0';
+      probe_line(&enters, start, now);
+      probe_line(&clicks, start, now);
+      start = end + 1;
+    }
+    line_len -= start - line_buf;
+    memmove(line_buf, start, line_len);
+  }
+  return got;
+}
+
+int
+main (int argc, char *argv[])
+{
+  static struct str_zone zones[MAX_ZONES];
+  const xcb_query_extension_reply_t *xtest;
+  xcb_screen_t *screen;
+  int rounds, wheel, zone_count, park_x, park_y;
+  long long expected, start, elapsed;
+
+  if (argc != 4) {
+    fprintf(stderr, "usage: xdrive <rounds> <wheel clicks> <broadcast socket>\n");
+    return 2;
+  }
+  rounds = atoi(argv[1]);
+  wheel = atoi(argv[2]);
+
+  connection = xcb_connect(NULL, NULL);
+  if (xcb_connection_has_error(connection)) {
+    fprintf(stderr, "xdrive: cannot connect to the X server\n");
+    return 1;
+  }
+  screen = xcb_setup_roots_iterator(xcb_get_setup(connection)).data;
+  root = screen->root;
+
+  xtest = xcb_get_extension_data(connection, &xcb_test_id);
+  if (!xtest || !xtest->present) {
+    fprintf(stderr, "xdrive: the X server has no XTEST extension\n");
+    return 1;
+  }
+
+  zone_count = find_zones(argv[3], zones);
+  if (zone_count == 0) {
+    fprintf(stderr, "xdrive: fittsmon reports no zones\n");
+    return 1;
+  }
+  find_park(zones, zone_count, screen->width_in_pixels, screen->height_in_pixels, &park_x, &park_y);
+  if ((sock = connect_socket(argv[3], SOCK_NONBLOCK)) < 0) return 1;
+  if (send(sock, "subscribe\n", 10, MSG_NOSIGNAL) != 10) {
+    fprintf(stderr, "xdrive: cannot subscribe: %s\n", strerror(errno));
+    return 1;
+  }
+
+  if (probe_init(&enters, (size_t)rounds * zone_count) < 0 ||
+      probe_init(&clicks, (size_t)rounds * zone_count) < 0) {
+    return 1;
+  }
+
+  /* Park the pointer outside every zone and wait until it is there */
+  inject(XCB_MOTION_NOTIFY, 0, park_x, park_y);
+  free(xcb_get_input_focus_reply(connection, xcb_get_input_focus(connection), NULL));
+
+  /* Enter, LeftButton, Leave, and WheelUp/WheelUpOnce/WheelDown/WheelDownOnce per scroll */
+  expected = (long long)rounds * zone_count * (3 + 4 * wheel);
+
+  start = now_ns();
+  for (int r = 0; r < rounds; r++) {
+    for (int z = 0; z < zone_count; z++) {
+      inject(XCB_MOTION_NOTIFY, 0, zones[z].x + zones[z].w / 2, zones[z].y + zones[z].h / 2);
+      xcb_flush(connection);
+      enters.sent[enters.sent_count++] = now_ns();
+      while (enters.seen < enters.sent_count && drain(IDLE_TIMEOUT_MS))
+        ;
+      if (enters.seen < enters.sent_count) {
+        fprintf(stderr, "xdrive: no Enter for zone at %d,%d\n", zones[z].x, zones[z].y);
+        goto done;
+      }
+
+      inject(XCB_BUTTON_PRESS, 1, 0, 0);
+      inject(XCB_BUTTON_RELEASE, 1, 0, 0);
+      xcb_flush(connection);
+      clicks.sent[clicks.sent_count++] = now_ns();
+
+      for (int w = 0; w < wheel; w++) {
+        inject(XCB_BUTTON_PRESS, 4, 0, 0);
+        inject(XCB_BUTTON_RELEASE, 4, 0, 0);
+        inject(XCB_BUTTON_PRESS, 5, 0, 0);
+        inject(XCB_BUTTON_RELEASE, 5, 0, 0);
+      }
+      inject(XCB_MOTION_NOTIFY, 0, park_x, park_y);
+      xcb_flush(connection);
+      drain(0);
+    }
+  }
+
+  while (lines < expected && drain(IDLE_TIMEOUT_MS))
+    ;
+
+done:
+  elapsed = last_line - start;
+
+  printf("zones          %d\n", zone_count);
+  printf("events         %lld of %lld dispatched\n", lines, expected);
+  if (elapsed > 0) printf("throughput     %.0f events/s\n", lines / (elapsed / 1e9));
+  probe_report(&enters, "enter latency");
+  probe_report(&clicks, "click latency");
+  xcb_disconnect(connection);
+  return lines == expected ? 0 : 1;
+}
@@ -0,0 +1,473 @@
+/**************************************************************************
+*
+* fittsmon : map mouse button events on screen corners to commands.
+*             Event broadcast to subscribers on a UNIX socket.
+*
+* Copyright (C) 2009 Yasen Atanasov (yasen.atanasov@gmail.com)
+* Modified 2025 by Eric Bakker (linuxbirdtweets@duck.com)
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License version 2
+* as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**************************************************************************/
+
+/*
+ * Every zone event, bound or not, is published as one line on
+ * $XDG_RUNTIME_DIR/fittsmon.sock, in the same format helpers get:
+ *
+ *     <zone> <event> <monitor> <X timestamp> <repeat count>\n
+ *
+ * A client may say what it wants in its first line. "subscribe" gets the
+ * events; so does a client that has sent nothing after 200 ms, such as
+ * socat or nc. The events since it connected are held back until then,
+ * so a query reply never starts with event lines.
+ *
+ * Sockets are non-blocking and each subscriber has a fixed buffer. Lines
+ * are written straight away when the socket takes them; what it does not
+ * take waits in the buffer for EPOLLOUT. A subscriber whose buffer cannot
+ * take the next line is disconnected, so a client that stops reading
+ * costs at most one buffer and never delays the X event path.
+ *
+ * "stats" gets the stats dump and is disconnected once it has been sent;
+ * that is what fittsmon --stats does. "zones" likewise gets the zone
+ * rectangles, one per line:
+ *
+ *     <monitor>-<zone> <x> <y> <width> <height>\n
+ */
+
+
+/* INCLUDES */
+
+#include "fittsmon.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+/* CONSTANTS/OPTIONS */
+
+#define BROADCAST_BUFFER_SIZE 8192
+
+/* Longest first line a client may send */
+#define BROADCAST_REQUEST_SIZE 32
+
+/* Time a client has for its first line before it counts as a subscriber */
+#define BROADCAST_FIRST_LINE_MS 200
+
+enum eSubscriberModes { SUBSCRIBER_NEW, SUBSCRIBER_EVENTS, SUBSCRIBER_QUERY };
+
+/* STRUCTS */
+
+struct str_subscriber {
+  int fd;
+  size_t len;                        /* bytes waiting in buf */
+  char *buf;                         /* BROADCAST_BUFFER_SIZE bytes, or a query reply */
+  char mode;                         /* eSubscriberModes; a query is closed when sent */
+  char out;                          /* watched for EPOLLOUT */
+  char request[BROADCAST_REQUEST_SIZE]; /* the first line, while mode is SUBSCRIBER_NEW */
+  size_t request_len;
+  long long deadline;                /* CLOCK_MONOTONIC ns the first line is due by */
+};
+
+/* GLOBALS */
+
+static int listen_fd = -1;
+static int deadline_fd = -1;         /* timerfd for the first-line deadlines */
+static struct sockaddr_un listen_addr;
+static struct str_subscriber subscribers[BROADCAST_MAX_SUBSCRIBERS];
+static int subscriber_count = 0;
+static unsigned long long subscribers_dropped = 0;
+
+/* implementations */
+
+/* Fill in the socket address. Returns NULL on success, else the reason
+   there is no socket. */
+static const char *
+broadcast_address (struct sockaddr_un *addr)
+{
+  const char *dir = getenv("XDG_RUNTIME_DIR");
+
+  unless (str_defined(dir)) return "XDG_RUNTIME_DIR is not set";
+
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  if (snprintf(addr->sun_path, sizeof(addr->sun_path), "%s/fittsmon.sock", dir) >=
+      (int)sizeof(addr->sun_path)) {
+    return "XDG_RUNTIME_DIR is too long for a socket path";
+  }
+  return NULL;
+}
+
+static void
+broadcast_drop (int i)
+{
+  if (subscriber_count == BROADCAST_MAX_SUBSCRIBERS) server_watch_modify(listen_fd, EPOLLIN);
+
+  server_unwatch(subscribers[i].fd);
+  close(subscribers[i].fd);
+  free(subscribers[i].buf);
+  subscribers[i] = subscribers[--subscriber_count];
+}
+
+/* Watch for room in the socket only while lines are waiting, and not
+   for the lines held back from a new client */
+static void
+broadcast_want_out (struct str_subscriber *subscriber)
+{
+  char out = subscriber->len > 0 && subscriber->mode != SUBSCRIBER_NEW;
+
+  if (out == subscriber->out) return;
+  server_watch_modify(subscriber->fd, EPOLLIN | (out ? EPOLLOUT : 0));
+  subscriber->out = out;
+}
+
+/* Write out what the socket takes. Returns 0 if the subscriber is gone. */
+static int
+broadcast_flush (struct str_subscriber *subscriber)
+{
+  while (subscriber->len > 0) {
+    ssize_t n = send(subscriber->fd, subscriber->buf, subscriber->len, MSG_NOSIGNAL);
+
+    if (n < 0) return errno == EAGAIN || errno == EINTR;
+    memmove(subscriber->buf, subscriber->buf + n, subscriber->len - n);
+    subscriber->len -= n;
+  }
+  return 1;
+}
+
+/* Publish one zone event to every subscriber */
+void
+broadcast_event (int win, int event, int mods, xcb_timestamp_t time, unsigned int count)
+{
+  char line[EVENT_LINE_MAX];
+  int len;
+
+  unless (subscriber_count) return;
+
+  /* Half a line would run into the next one */
+  if ((len = dispatch_format(line, sizeof(line), win, event, mods, time, count)) < 0) return;
+
+  for (int i = subscriber_count - 1; i >= 0; i--) {
+    struct str_subscriber *subscriber = &subscribers[i];
+
+    if (subscriber->mode == SUBSCRIBER_QUERY) continue;
+
+    /* Held back until the client has said what it wants; if it says
+       nothing for long, the oldest lines it would have missed anyway */
+    if (subscriber->mode == SUBSCRIBER_NEW) {
+      if (subscriber->len + len <= BROADCAST_BUFFER_SIZE) {
+        memcpy(subscriber->buf + subscriber->len, line, len);
+        subscriber->len += len;
+      }
+      continue;
+    }
+
+    if (subscriber->len + len > BROADCAST_BUFFER_SIZE) {
+      fprintf(stderr, "Warning: Dropping a subscriber that stopped reading events\n");
+      subscribers_dropped++;
+      broadcast_drop(i);
+      continue;
+    }
+
+    memcpy(subscriber->buf + subscriber->len, line, len);
+    subscriber->len += len;
+    unless (broadcast_flush(subscriber)) {
+      broadcast_drop(i);
+      continue;
+    }
+    broadcast_want_out(subscriber);
+  }
+}
+
+/* Give a subscriber the reply to its query in place of events: the
+   stats dump SIGUSR1 prints, or the zones. Returns 0 if the subscriber is
+   done. */
+static int
+broadcast_answer (struct str_subscriber *subscriber, void (*print)(FILE *out))
+{
+  char *reply = NULL;
+  size_t size = 0;
+  FILE *out = open_memstream(&reply, &size);
+
+  unless (out) return 0;
+  print(out);
+  fclose(out);
+
+  free(subscriber->buf);
+  subscriber->buf = reply;
+  subscriber->len = size;
+  subscriber->mode = SUBSCRIBER_QUERY;
+
+  return broadcast_flush(subscriber) && subscriber->len > 0;
+}
+
+/* Act on a new client's first line. Returns 0 if it is to be dropped. */
+static int
+broadcast_request (struct str_subscriber *subscriber, const char *line)
+{
+  if (strcmp(line, "subscribe") == 0) {
+    subscriber->mode = SUBSCRIBER_EVENTS;
+    return broadcast_flush(subscriber);
+  }
+  if (strcmp(line, "stats") == 0) return broadcast_answer(subscriber, server_print_stats);
+  if (strcmp(line, "zones") == 0) return broadcast_answer(subscriber, server_print_zones);
+  return 0;
+}
+
+/* Set the timer to the earliest first-line deadline, or disarm it */
+static void
+broadcast_arm (void)
+{
+  struct itimerspec spec;
+  long long deadline = 0;
+
+  for (int i = 0; i < subscriber_count; i++) {
+    if (subscribers[i].mode != SUBSCRIBER_NEW) continue;
+    if (!deadline || subscribers[i].deadline < deadline) deadline = subscribers[i].deadline;
+  }
+
+  memset(&spec, 0, sizeof(spec));
+  spec.it_value.tv_sec = deadline / 1000000000;
+  spec.it_value.tv_nsec = deadline % 1000000000;
+  timerfd_settime(deadline_fd, TFD_TIMER_ABSTIME, &spec, NULL);
+}
+
+/* The first-line deadline passed: a client that sent nothing is a plain
+   subscriber, one that sent part of a line is taken at its word */
+static void
+broadcast_deadline (int fd, uint32_t events)
+{
+  long long now = stats_now_ns();
+  uint64_t expirations;
+
+  /* Nothing to read when it was re-armed in the meantime */
+  if (read(fd, &expirations, sizeof(expirations)) < 0) return;
+
+  for (int i = subscriber_count - 1; i >= 0; i--) {
+    struct str_subscriber *subscriber = &subscribers[i];
+
+    unless (subscriber->mode == SUBSCRIBER_NEW && subscriber->deadline <= now) continue;
+
+    subscriber->request[subscriber->request_len] = '\0';
+    unless (broadcast_request(subscriber, subscriber->request_len ? subscriber->request : "subscribe")) {
+      broadcast_drop(i);
+      continue;
+    }
+    broadcast_want_out(subscriber);
+  }
+  broadcast_arm();
+}
+
+/* A subscriber's fd said something: its first line, its leaving, or room
+   for the lines waiting in its buffer */
+static void
+broadcast_subscriber (int fd, uint32_t events)
+{
+  struct str_subscriber *subscriber;
+  char discard[256];
+  int j;
+
+  for (j = 0; j < subscriber_count && subscribers[j].fd != fd; j++)
+    ;
+  if (j == subscriber_count) return;
+  subscriber = &subscribers[j];
+
+  if (events & (EPOLLERR | EPOLLHUP)) {
+    broadcast_drop(j);
+    return;
+  }
+  if (events & EPOLLIN) {
+    /* After the first line only EOF matters: it means they left */
+    int first = subscriber->mode == SUBSCRIBER_NEW;
+    ssize_t r = first ? recv(fd, subscriber->request + subscriber->request_len,
+                             BROADCAST_REQUEST_SIZE - subscriber->request_len, 0)
+                      : recv(fd, discard, sizeof(discard), 0);
+    char *newline;
+
+    if (r == 0 || (r < 0 && errno != EAGAIN && errno != EINTR)) {
+      broadcast_drop(j);
+      return;
+    }
+    if (r > 0 && first) {
+      subscriber->request_len += r;
+      newline = memchr(subscriber->request, '\n', subscriber->request_len);
+
+      /* Anything but a known request, whole, is not a client of ours */
+      if (newline) *newline = '\0';
+      if ((newline || subscriber->request_len == BROADCAST_REQUEST_SIZE) &&
+          !(newline && broadcast_request(subscriber, subscriber->request))) {
+        broadcast_drop(j);
+        return;
+      }
+    }
+  }
+  if ((events & EPOLLOUT) &&
+      (!broadcast_flush(subscriber) || (subscriber->mode == SUBSCRIBER_QUERY && subscriber->len == 0))) {
+    broadcast_drop(j);
+    return;
+  }
+  broadcast_want_out(subscriber);
+}
+
+/* Take new subscribers, as many as there is room for */
+static void
+broadcast_accept (int fd, uint32_t events)
+{
+  while (subscriber_count < BROADCAST_MAX_SUBSCRIBERS &&
+         (fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+    struct str_subscriber *subscriber = &subscribers[subscriber_count];
+
+    unless ((subscriber->buf = malloc(BROADCAST_BUFFER_SIZE))) {
+      close(fd);
+      break;
+    }
+    if (server_watch(fd, EPOLLIN, broadcast_subscriber) < 0) {
+      free(subscriber->buf);
+      close(fd);
+      break;
+    }
+    subscriber->fd = fd;
+    subscriber->len = 0;
+    subscriber->out = 0;
+    subscriber->request_len = 0;
+    subscriber->deadline = stats_now_ns() + BROADCAST_FIRST_LINE_MS * 1000000LL;
+    /* Without the timer nobody would end the wait: subscribe at once */
+    subscriber->mode = deadline_fd >= 0 ? SUBSCRIBER_NEW : SUBSCRIBER_EVENTS;
+    subscriber_count++;
+  }
+  if (deadline_fd >= 0) broadcast_arm();
+
+  /* Full: leave the rest in the backlog until someone leaves */
+  if (subscriber_count == BROADCAST_MAX_SUBSCRIBERS) server_watch_modify(listen_fd, 0);
+}
+
+/* Create the socket. Returns 0 on success; without $XDG_RUNTIME_DIR, or
+   when another fittsmon already serves the path, there is no broadcast. */
+int
+broadcast_start (void)
+{
+  const char *error = broadcast_address(&listen_addr);
+  int probe;
+
+  if (error) {
+    fprintf(stderr, "Warning: %s, event broadcast disabled\n", error);
+    return -1;
+  }
+
+  /* A socket nobody answers on is left over from an earlier run */
+  probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (probe >= 0 && connect(probe, (struct sockaddr *)&listen_addr, sizeof(listen_addr)) == 0) {
+    fprintf(stderr, "Warning: %s is in use by another fittsmon, event broadcast disabled\n",
+            listen_addr.sun_path);
+    close(probe);
+    return -1;
+  }
+  if (probe >= 0) close(probe);
+  unlink(listen_addr.sun_path);
+
+  listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listen_fd < 0 ||
+      bind(listen_fd, (struct sockaddr *)&listen_addr, sizeof(listen_addr)) < 0 ||
+      listen(listen_fd, 8) < 0) {
+    fprintf(stderr, "Warning: Cannot listen on %s: %s\n", listen_addr.sun_path, strerror(errno));
+    if (listen_fd >= 0) close(listen_fd);
+    listen_fd = -1;
+    return -1;
+  }
+
+  if (server_watch(listen_fd, EPOLLIN, broadcast_accept) < 0) {
+    close(listen_fd);
+    listen_fd = -1;
+    return -1;
+  }
+
+  /* First-line deadlines */
+  deadline_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (deadline_fd >= 0 && server_watch(deadline_fd, EPOLLIN, broadcast_deadline) < 0) {
+    close(deadline_fd);
+    deadline_fd = -1;
+  }
+  if (deadline_fd < 0) fprintf(stderr, "Warning: Clients of %s get events at once\n", listen_addr.sun_path);
+
+  printf("Broadcasting events on %s\n", listen_addr.sun_path);
+  return 0;
+}
+
+/* Disconnect the subscribers and remove the socket */
+void
+broadcast_stop (void)
+{
+  if (listen_fd < 0) return;
+
+  while (subscriber_count) broadcast_drop(subscriber_count - 1);
+  server_unwatch(listen_fd);
+  close(listen_fd);
+  listen_fd = -1;
+  unlink(listen_addr.sun_path);
+
+  if (deadline_fd >= 0) {
+    server_unwatch(deadline_fd);
+    close(deadline_fd);
+    deadline_fd = -1;
+  }
+}
+
+void
+broadcast_print_stats (FILE *out)
+{
+  if (listen_fd < 0) return;
+
+  fprintf(out, "Broadcast: %d subscribers, %llu dropped for not reading\n", subscriber_count,
+          subscribers_dropped);
+  fflush(out);
+}
+
+/* Client side of fittsmon --stats and --zones: send a request line to the running
+   instance and copy its reply to stdout. Returns the exit status. */
+int
+broadcast_query (const char *request)
+{
+  struct sockaddr_un addr;
+  const char *error = broadcast_address(&addr);
+  char buf[4096];
+  int len;
+  ssize_t n;
+  int fd;
+
+  if (error) {
+    fprintf(stderr, "Error: %s\n", error);
+    return 1;
+  }
+
+  fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    fprintf(stderr, "Error: No fittsmon is running on %s: %s\n", addr.sun_path, strerror(errno));
+    if (fd >= 0) close(fd);
+    return 1;
+  }
+
+  len = snprintf(buf, sizeof(buf), "%s\n", request);
+  if (send(fd, buf, len, MSG_NOSIGNAL) < 0) {
+    perror("send");
+    close(fd);
+    return 1;
+  }
+
+  while ((n = read(fd, buf, sizeof(buf))) > 0) fwrite(buf, 1, n, stdout);
+  close(fd);
+  return n < 0;
+}
@@ -0,0 +1,987 @@
+/**************************************************************************
+*
+* fittsmon : map mouse button events on screen corners to commands.
+*             fittsmonrc parsing, binding tables and live reload.
+*
+* Copyright (C) 2009 Yasen Atanasov (yasen.atanasov@gmail.com)
+* Modified 2025 by Eric Bakker (linuxbirdtweets@duck.com)
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License version 2
+* as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**************************************************************************/
+
+
+/* INCLUDES */
+
+#include "fittsmon.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <pwd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/* CONSTANTS/OPTIONS */
+
+const char *section_names[8] = {
+  "TopLeft", "TopCenter", "TopRight", "Right", "BottomRight", "BottomCenter", "BottomLeft", "Left"
+};
+const char *event_names[EVENT_COUNT] = {
+  "LeftButton", "MiddleButton", "RightButton", "WheelUp", "WheelDown", "WheelUpOnce", "WheelDownOnce", "Enter", "Leave",
+  "WheelLeft", "WheelRight", "Button8", "Button9"
+};
+
+/* Written Modifier+Event, in the order of their bits in the reduced mask */
+const char *modifier_names[4] = { "Shift", "Ctrl", "Alt", "Super" };
+
+/* Group keys other than events; they take the same options */
+static const char *group_keys[] = { "Helper", "Command" };
+
+/* Per-binding options, written Event.Option=value */
+static const char *binding_options[] = { "Shell", "Coalesce", "Rate", "Burst", "Dwell", "Policy" };
+
+/* Zone geometry, in a zone section and in [Settings]; indexes into
+   str_zone_rule values */
+static const char *geometry_keys[] = { "X", "Y", "Width", "Height" };
+static const char *size_keys[] = { "CornerSize", "EdgeThickness", "EdgeLength" };
+
+/* Keys that take no Event.Option */
+static const char *layout_keys[] = {
+  "X", "Y", "Width", "Height", "CornerSize", "EdgeThickness", "EdgeLength", "Zones",
+  "Gestures", "Sequence", "Within"
+};
+
+/* Time limit of a gesture without Within= */
+#define GESTURE_WITHIN_MS 400
+
+#define ARRAY_LEN(a) ( sizeof(a) / sizeof((a)[0]) )
+
+/* GLOBALS */
+
+/* The binding table events are dispatched against. Only the X reader
+   thread reads or replaces this pointer. */
+struct str_bindings *bindings = NULL;
+
+const struct str_command command_unbound;
+
+static char *config_file_path = NULL;
+static int config_watch_fd = -1;
+
+/* implementations */
+
+/* An empty table for zone_count zones, with the 8 positions at their
+   default geometry. The slots share its allocation. */
+struct str_bindings *
+bindings_new (int zone_count)
+{
+  struct str_bindings *table;
+
+  table = calloc(1, sizeof(struct str_bindings) + (size_t)zone_count * EVENT_COUNT * MOD_COUNT * sizeof(unsigned short));
+  unless (table) return NULL;
+
+  table->refs = 1;
+  table->zone_count = zone_count;
+  table->slots = (unsigned short *)(table + 1);
+  table->layout.zone_count = 8;
+  return table;
+}
+
+static void
+layout_clear (struct str_layout *layout)
+{
+  for (int i = 0; i < layout->rule_count; i++) free(layout->rules[i].monitor);
+  free(layout->rules);
+  for (int i = 0; layout->names && layout->names[i]; i++) free(layout->names[i]);
+  free(layout->names);
+  memset(layout, 0, sizeof(*layout));
+}
+
+void
+bindings_ref (struct str_bindings *table)
+{
+  __atomic_add_fetch(&table->refs, 1, __ATOMIC_RELAXED);
+}
+
+/* Drop a reference; the last one frees the table and its commands. Called
+   from the X reader and the launcher thread alike. */
+void
+bindings_unref (struct str_bindings *table)
+{
+  unless (table) return;
+  if (__atomic_sub_fetch(&table->refs, 1, __ATOMIC_ACQ_REL) > 0) return;
+
+  for (int i = 0; i < table->command_count; i++) command_clear(&table->commands[i]);
+  free(table->commands);
+  layout_clear(&table->layout);
+  gesture_clear(&table->gestures);
+  free(table);
+}
+
+/* Make table the current binding table and lay the zones out the way it
+   says. The swap happens between two events, so every event sees either
+   the old or the new config in full; actions already queued keep the old
+   table alive until they are done. Returns -1, dropping table, if the
+   zones it defines do not fit in memory. */
+static int
+bindings_install (struct str_bindings *table)
+{
+  struct str_bindings *old = bindings;
+
+  /* A pending burst was collected under the old config */
+  dispatch_flush();
+  /* Spans name their zone */
+  trace_flush();
+
+  /* Zone indexes depend on how many zones a monitor has */
+  if (zones_resize(table->layout.zone_count) < 0) {
+    bindings_unref(table);
+    return -1;
+  }
+
+  bindings = table;
+  gesture_reset();
+  zones_configure();
+  helpers_sync(table);
+  bindings_unref(old);
+  return 0;
+}
+
+/* Parse the len bytes of [Modifier+...]Event. Returns the event, with the
+   modifiers' mask in mods, or -1. Enter and Leave take no modifiers. */
+static int
+config_parse_event (const char *key, size_t len, int *mods)
+{
+  const char *plus;
+  unsigned int i;
+
+  *mods = 0;
+  while ((plus = memchr(key, '+', len))) {
+    for (i = 0; i < ARRAY_LEN(modifier_names); i++) {
+      if (strlen(modifier_names[i]) == (size_t)(plus - key) && strncmp(key, modifier_names[i], plus - key) == 0) break;
+    }
+    if (i == ARRAY_LEN(modifier_names)) return -1;
+    *mods |= 1 << i;
+    len -= plus + 1 - key;
+    key = plus + 1;
+  }
+
+  for (i = 0; i < ARRAY_LEN(event_names); i++) {
+    unless (strlen(event_names[i]) == len && strncmp(key, event_names[i], len) == 0) continue;
+    if (*mods && (i == Enter || i == Leave)) return -1;
+    return i;
+  }
+  return -1;
+}
+
+/* Is key a known Event or Event.Option name */
+static int
+config_known_key (const char *key, size_t len)
+{
+  const char *dot = memchr(key, '.', len);
+  size_t event_len = dot ? (size_t)(dot - key) : len;
+  unsigned int i;
+  int mods;
+
+  if (config_parse_event(key, event_len, &mods) < 0) {
+    unless (dot) {
+      for (i = 0; i < ARRAY_LEN(layout_keys); i++) {
+        if (strlen(layout_keys[i]) == len && strncmp(key, layout_keys[i], len) == 0) return 1;
+      }
+    }
+    for (i = 0; i < ARRAY_LEN(group_keys); i++) {
+      if (strlen(group_keys[i]) == event_len && strncmp(key, group_keys[i], event_len) == 0) break;
+    }
+    if (i == ARRAY_LEN(group_keys)) return 0;
+  }
+  unless (dot) return 1;
+
+  for (i = 0; i < ARRAY_LEN(binding_options); i++) {
+    size_t option_len = len - event_len - 1;
+    if (strlen(binding_options[i]) == option_len && strncmp(dot + 1, binding_options[i], option_len) == 0) return 1;
+  }
+  return 0;
+}
+
+/* Commands of a table being built, with the fittsmonrc value each one was
+   parsed from so repeats can be found without parsing them again. The
+   values point into the mapped file. */
+struct str_intern {
+  struct str_bindings *table;
+  const char **values;
+  int capacity;
+  unsigned char *named;  /* per slot: a binding asked for exactly these modifiers */
+};
+
+/* Index + 1 of the command for value with the options set in options, parsed and added
+   on first use. Returns 0 if the table cannot take another command. */
+static unsigned short
+config_intern (struct str_intern *intern, const char *value, const struct str_command *options)
+{
+  struct str_bindings *table = intern->table;
+  struct str_command *command;
+  long long start;
+  int i;
+
+  for (i = 0; i < table->command_count; i++) {
+    const struct str_command *known = &table->commands[i];
+
+    if (known->shell == options->shell && known->helper == options->helper &&
+        known->coalesce_ms == options->coalesce_ms && known->dwell_ms == options->dwell_ms &&
+        known->rate == options->rate && known->burst == options->burst &&
+        known->policy == options->policy && known->queue_max == options->queue_max &&
+        strcmp(intern->values[i], value) == 0) {
+      return i + 1;
+    }
+  }
+
+  if (table->command_count == 0xffff) return 0;
+
+  if (table->command_count == intern->capacity) {
+    int capacity = intern->capacity ? intern->capacity * 2 : 16;
+    struct str_command *commands = realloc(table->commands, capacity * sizeof(struct str_command));
+    const char **values;
+
+    unless (commands) return 0;
+    table->commands = commands;
+    unless ((values = realloc(intern->values, capacity * sizeof(char *)))) return 0;
+    intern->values = values;
+    intern->capacity = capacity;
+  }
+
+  command = &table->commands[table->command_count];
+  memset(command, 0, sizeof(*command));
+  start = trace_now();
+  command_parse(command, value, options->shell);
+  trace_span(TRACE_VALIDATE, start, -1, -1, table->command_count);
+  command->helper = options->helper;
+  command->coalesce_ms = options->coalesce_ms;
+  command->dwell_ms = options->dwell_ms;
+  command->rate = options->rate;
+  command->burst = options->burst;
+  command->policy = options->policy;
+  command->queue_max = options->queue_max;
+  intern->values[table->command_count] = value;
+
+  return ++table->command_count;
+}
+
+/* Event.Policy=parallel, single, replace or queue:N */
+static void
+config_read_policy (struct str_rcfile *rc, int group, const char *key, struct str_command *options)
+{
+  const struct str_rc_entry *entry = rc_lookup(rc, group, key, "Policy");
+  unsigned long max;
+  char *end;
+
+  unless (entry) return;
+
+  if (strcmp(entry->value, "parallel") == 0) {
+    options->policy = POLICY_PARALLEL;
+  } else if (strcmp(entry->value, "single") == 0) {
+    options->policy = POLICY_SINGLE;
+  } else if (strcmp(entry->value, "replace") == 0) {
+    options->policy = POLICY_REPLACE;
+  } else if (strncmp(entry->value, "queue:", 6) == 0 && (max = strtoul(entry->value + 6, &end, 10)) > 0 &&
+             max <= 0xffff && *end == '\0') {
+    options->policy = POLICY_QUEUE;
+    options->queue_max = (unsigned short)max;
+  } else {
+    rc_bad_value(rc, entry, "parallel, single, replace or queue:N");
+  }
+}
+
+/* Bind one [Modifier+]Event=command entry of a section, with its
+   Event.Option settings, to a zone. A binding without modifiers also
+   takes every modifier mask no binding asks for by name. Returns the
+   command, NULL if the entry is not an event or is set again further on. */
+static const struct str_command *
+config_read_command (struct str_rcfile *rc, int group, const struct str_rc_entry *entry,
+                     struct str_intern *intern, int zone)
+{
+  const char *key = entry->key;
+  struct str_command options;
+  unsigned short index;
+  size_t base;
+  double number;
+  int event, mods;
+
+  if (strchr(key, '.') || (event = config_parse_event(key, strlen(key), &mods)) < 0) return NULL;
+  unless (rc_lookup(rc, group, key, NULL) == entry) return NULL;
+
+  memset(&options, 0, sizeof(options));
+
+  options.shell = rc_boolean(rc, group, key, "Shell");
+
+  number = rc_number(rc, group, key, "Coalesce", 0);
+  options.coalesce_ms = number > 0 ? (unsigned int)number : 0;
+
+  number = rc_number(rc, group, key, "Dwell", 0);
+  options.dwell_ms = number > 0 ? (unsigned int)number : 0;
+
+  /* The *Once events keep their old meaning, one launch per two seconds,
+     unless the file says otherwise; Rate=0 lifts the limit */
+  number = rc_number(rc, group, key, "Rate", (event == WheelUpOnce || event == WheelDownOnce) ? 0.5 : 0);
+  options.rate = number > 0 ? (float)number : 0;
+
+  number = rc_number(rc, group, key, "Burst", 1);
+  options.burst = number >= 1 ? (unsigned int)number : 1;
+
+  config_read_policy(rc, group, key, &options);
+
+  index = config_intern(intern, entry->value, &options);
+
+  base = ((size_t)zone * EVENT_COUNT + event) * MOD_COUNT;
+  for (int m = 0; m < MOD_COUNT; m++) {
+    if (m == mods || (mods == 0 && !intern->named[base + m])) intern->table->slots[base + m] = index;
+  }
+  intern->named[base + mods] = 1;
+
+  return bindings_lookup(intern->table, zone, event, mods);
+}
+
+
+/* Route the events of zones first_zone..first_zone+zone_count-1 to the
+   section's Helper= process. Events with a command of their own keep it;
+   a helper set later replaces one set earlier, so [Settings] goes first. Returns the helper's
+   command, NULL if the section names none. */
+static const struct str_command *
+config_read_helper (struct str_rcfile *rc, int group, struct str_intern *intern, int first_zone, int zone_count)
+{
+  struct str_bindings *table = intern->table;
+  struct str_command options;
+  unsigned short index;
+  const char *value;
+
+  unless ((value = rc_value(rc, group, "Helper"))) return NULL;
+
+  memset(&options, 0, sizeof(options));
+  options.shell = rc_boolean(rc, group, "Helper", "Shell");
+  options.helper = 1;
+  index = config_intern(intern, value, &options);
+
+  for (size_t k = (size_t)first_zone * EVENT_COUNT * MOD_COUNT;
+       k < (size_t)(first_zone + zone_count) * EVENT_COUNT * MOD_COUNT; k++) {
+    unsigned short *slot = &table->slots[k];
+
+    if (*slot == 0 || table->commands[*slot - 1].helper) *slot = index;
+  }
+
+  return index ? &table->commands[index - 1] : NULL;
+}
+/* Name of one of a layout's zones */
+static const char *
+layout_name (const struct str_layout *layout, int zone)
+{
+  return zone < 8 ? section_names[zone] : layout->names[zone - 8];
+}
+
+/* The geometry fittsmonrc gives a zone on a monitor, zone -1 for the
+   [Settings] sizes: sections for every monitor first, then the monitor's
+   own. Fills in the values given and returns their bits. */
+unsigned int
+layout_lookup (const struct str_layout *layout, int zone, const char *monitor, struct str_length values[4])
+{
+  unsigned int set = 0;
+
+  for (int pass = 0; pass < 2; pass++) {
+    for (int i = 0; i < layout->rule_count; i++) {
+      const struct str_zone_rule *rule = &layout->rules[i];
+
+      unless (rule->zone == zone) continue;
+      unless (pass ? rule->monitor && strcmp(rule->monitor, monitor) == 0 : !rule->monitor) continue;
+
+      for (int k = 0; k < 4; k++) {
+        if (rule->set & (1 << k)) values[k] = rule->values[k];
+      }
+      set |= rule->set;
+    }
+  }
+  return set;
+}
+
+
+/* Parse 12, 12px or 12.5% */
+static int
+config_parse_length (const char *text, struct str_length *length)
+{
+  char *end;
+  double value = strtod(text, &end);
+
+  if (end == text || value < 0) return -1;
+
+  length->percent = 0;
+  if (*end == '%') {
+    length->percent = 1;
+    end++;
+  } else if (strncmp(end, "px", 2) == 0) {
+    end += 2;
+  }
+  while (*end == ' ' || *end == '\t') end++;
+  if (*end) return -1;
+
+  length->value = (float)value;
+  return 0;
+}
+
+/* Which zone a section is for, going by its name, Zone or Monitor-Zone;
+   Settings counts as zone -1. Returns -2 for any other section. monitor
+   gets a copy of the monitor name, NULL in a section for every monitor. */
+static int
+config_group_zone (const struct str_layout *layout, const char *group, char **monitor)
+{
+  size_t len = strlen(group);
+
+  *monitor = NULL;
+  for (int zone = -1; zone < layout->zone_count; zone++) {
+    const char *name = zone < 0 ? "Settings" : layout_name(layout, zone);
+    size_t name_len = strlen(name);
+
+    if (strcmp(group, name) == 0) return zone;
+    if (len > name_len + 1 && group[len - name_len - 1] == '-' && strcmp(group + len - name_len, name) == 0) {
+      *monitor = strndup(group, len - name_len - 1);
+      return zone;
+    }
+  }
+  return -2;
+}
+
+/* Is name usable as a zone or gesture section: letters, digits and '_' */
+static int
+config_valid_name (const char *name)
+{
+  const char *c;
+
+  for (c = name; isalnum((unsigned char)*c) || *c == '_'; c++)
+    ;
+  return *name && !*c;
+}
+
+/* Read the named zones of [Settings] Zones= and the geometry of every
+   section into layout. Returns the number of errors. */
+static int
+config_read_layout (struct str_rcfile *rc, struct str_layout *layout)
+{
+  const struct str_rc_entry *zones = rc_lookup(rc, rc_group(rc, "Settings"), "Zones", NULL);
+  char *cursor = zones ? zones->value : NULL;
+  char *name;
+  int errors = 0;
+  int g, k;
+
+  memset(layout, 0, sizeof(*layout));
+  layout->zone_count = 8;
+
+  while ((name = rc_list_next(&cursor))) {
+    char **names = realloc(layout->names, (layout->zone_count - 8 + 2) * sizeof(char *));
+    char *monitor;
+
+    unless (names && (names[layout->zone_count - 8] = strdup(name))) {
+      if (names) layout->names = names;
+      fprintf(stderr, "%s: %s\n", rc->path, strerror(ENOMEM));
+      return errors + 1;
+    }
+    layout->names = names;
+
+    if (!config_valid_name(name)) {
+      fprintf(stderr, "%s:%d: error: zone name '%s' may only have letters, digits and '_'\n", rc->path, zones->line, name);
+      errors++;
+    } else if (config_group_zone(layout, name, &monitor) != -2) {
+      free(monitor);
+      fprintf(stderr, "%s:%d: error: zone name '%s' is taken\n", rc->path, zones->line, name);
+      errors++;
+    }
+    layout->zone_count++;
+    layout->names[layout->zone_count - 8] = NULL;
+  }
+
+  for (g = 0; g < rc->group_count; g++) {
+    struct str_zone_rule rule, *rules;
+    const char **keys;
+    int key_count;
+
+    memset(&rule, 0, sizeof(rule));
+    rule.zone = config_group_zone(layout, rc->groups[g].name, &rule.monitor);
+    if (rule.zone == -2) continue;
+
+    keys = rule.zone < 0 ? size_keys : geometry_keys;
+    key_count = rule.zone < 0 ? ARRAY_LEN(size_keys) : ARRAY_LEN(geometry_keys);
+
+    for (k = 0; k < key_count; k++) {
+      const struct str_rc_entry *entry = rc_lookup(rc, g, keys[k], NULL);
+
+      unless (entry) continue;
+      if (config_parse_length(entry->value, &rule.values[k]) < 0) {
+        fprintf(stderr, "%s:%d: error: %s=%s: expected pixels or a percentage\n", rc->path, entry->line,
+                keys[k], entry->value);
+        errors++;
+      } else {
+        rule.set |= 1 << k;
+      }
+    }
+
+    unless (rule.set && (rules = realloc(layout->rules, (layout->rule_count + 1) * sizeof(struct str_zone_rule)))) {
+      free(rule.monitor);
+      continue;
+    }
+    layout->rules = rules;
+    layout->rules[layout->rule_count++] = rule;
+  }
+
+  return errors;
+}
+
+/* Read the gestures [Settings] Gestures= names, each from a section of
+   its own, and compile them. A step without a monitor is on the monitor
+   the gesture is on, so such a gesture is repeated for every enabled
+   monitor. Returns the number of errors. */
+static int
+config_read_gestures (struct str_rcfile *rc, struct str_intern *intern)
+{
+  struct str_bindings *table = intern->table;
+  const struct str_layout *layout = &table->layout;
+  struct str_gestures *gestures = &table->gestures;
+  const struct str_rc_entry *names = rc_lookup(rc, rc_group(rc, "Settings"), "Gestures", NULL);
+  char *cursor = names ? names->value : NULL;
+  char *name;
+  int errors = 0;
+
+  while ((name = rc_list_next(&cursor))) {
+    int zones[GESTURE_MAX_STEPS], events[GESTURE_MAX_STEPS];
+    int owners[GESTURE_MAX_STEPS];  /* monitor of the step, -1 for the gesture's, -2 if absent */
+    const struct str_rc_entry *sequence;
+    struct str_command options;
+    unsigned short command;
+    unsigned int within;
+    int length = 0, any_monitor = 0, absent = 0;
+    int errors_before = errors;
+    char *step, *save, *value, *monitor;
+    double number;
+    int group, m, k;
+
+    unless (config_valid_name(name)) {
+      fprintf(stderr, "%s:%d: error: gesture name '%s' may only have letters, digits and '_'\n", rc->path,
+              names->line, name);
+      errors++;
+      continue;
+    }
+    if (config_group_zone(layout, name, &monitor) != -2) {
+      free(monitor);
+      fprintf(stderr, "%s:%d: error: gesture name '%s' is taken\n", rc->path, names->line, name);
+      errors++;
+      continue;
+    }
+
+    group = rc_group(rc, name);
+    unless ((sequence = rc_lookup(rc, group, "Sequence", NULL))) {
+      fprintf(stderr, "%s:%d: error: [%s] needs Sequence=Zone:Event Zone:Event...\n", rc->path,
+              group < 0 ? names->line : rc->groups[group].line, name);
+      errors++;
+      continue;
+    }
+
+    for (step = strtok_r(sequence->value, " \t", &save); step; step = strtok_r(NULL, " \t", &save)) {
+      char *colon = strrchr(step, ':');
+      int zone = -2, event;
+
+      monitor = NULL;
+      if (length == GESTURE_MAX_STEPS) {
+        fprintf(stderr, "%s:%d: error: [%s] has more than %d steps\n", rc->path, sequence->line, name,
+                GESTURE_MAX_STEPS);
+        errors++;
+        break;
+      }
+
+      for (event = 0; colon && event < EVENT_COUNT; event++) {
+        if (strcmp(colon + 1, event_names[event]) == 0) break;
+      }
+      if (colon && event < EVENT_COUNT) {
+        *colon = '\0';
+        zone = config_group_zone(layout, step, &monitor);
+        *colon = ':';
+      }
+      if (zone < 0) {
+        /* Monitor-Settings is a section, but no zone */
+        free(monitor);
+        fprintf(stderr, "%s:%d: error: Sequence: '%s' is not Zone:Event\n", rc->path, sequence->line, step);
+        errors++;
+        continue;
+      }
+
+      owners[length] = -1;
+      if (monitor) {
+        owners[length] = -2;
+        for (m = 0; m < monitor_count; m++) {
+          if (monitors[m].enabled && strcmp(monitors[m].name, monitor) == 0) owners[length] = m;
+        }
+        free(monitor);
+      }
+      if (owners[length] == -1) any_monitor = 1;
+      if (owners[length] == -2) absent = 1;
+      zones[length] = zone;
+      events[length] = event;
+      length++;
+    }
+
+    if (errors == errors_before && length < 2) {
+      fprintf(stderr, "%s:%d: error: [%s] needs at least two steps\n", rc->path, sequence->line, name);
+      errors++;
+    }
+
+    number = rc_number(rc, group, "Within", NULL, GESTURE_WITHIN_MS);
+    if (number < 1) {
+      fprintf(stderr, "%s:%d: error: Within= is a time in milliseconds\n", rc->path,
+              rc_lookup(rc, group, "Within", NULL)->line);
+      errors++;
+    }
+    within = (unsigned int)number;
+
+    unless ((value = rc_value(rc, group, "Command"))) {
+      fprintf(stderr, "%s:%d: error: [%s] needs Command=\n", rc->path, rc->groups[group].line, name);
+      errors++;
+      continue;
+    }
+    memset(&options, 0, sizeof(options));
+    options.shell = rc_boolean(rc, group, "Command", "Shell");
+    config_read_policy(rc, group, "Command", &options);
+    command = config_intern(intern, value, &options);
+
+    /* A gesture on a monitor that is not in use is simply not there */
+    if (errors > errors_before || absent || !command) continue;
+
+    for (m = 0; m < monitor_count; m++) {
+      struct str_gesture *gesture, *list;
+
+      unless (monitors[m].enabled) continue;
+
+      unless ((list = realloc(gestures->list, (gestures->count + 1) * sizeof(struct str_gesture)))) break;
+      gestures->list = list;
+      gesture = &list[gestures->count];
+      memset(gesture, 0, sizeof(*gesture));
+      unless ((gesture->steps = malloc(length * sizeof(int))) && (gesture->name = strdup(name))) {
+        free(gesture->steps);
+        break;
+      }
+      gestures->count++;
+
+      for (k = 0; k < length; k++) {
+        gesture->steps[k] = ((owners[k] >= 0 ? owners[k] : m) * layout->zone_count + zones[k]) * EVENT_COUNT +
+                            events[k];
+      }
+      gesture->length = length;
+      gesture->within_ms = within;
+      gesture->command = command;
+
+      printf("Gesture %s : %s (monitor: %s)\n", name, table->commands[command - 1].line,
+             monitors[gesture->steps[0] / EVENT_COUNT / layout->zone_count].name);
+
+      /* Every step names its monitor: once is enough */
+      unless (any_monitor) break;
+    }
+  }
+
+  if (errors == 0 && gesture_compile(gestures, table->zone_count) < 0) {
+    fprintf(stderr, "%s: too many gestures\n", rc->path);
+    errors++;
+  }
+  return errors;
+}
+
+/* Build a complete binding table from fittsmonrc for every enabled
+   monitor. Returns NULL, leaving nothing half-applied, if the file cannot
+   be read or does not parse. */
+struct str_bindings *
+config_read_file (const char *file_path)
+{
+  struct str_intern intern = { NULL, NULL, 0, NULL };
+  const struct str_command *helper, *command;
+  struct str_layout layout;
+  struct str_rcfile rc;
+  int i, k, m, g, errors;
+
+  if (rc_open(&rc, file_path, config_known_key) < 0) return NULL;
+
+  if (rc.errors > 0) {
+    rc_close(&rc);
+    return NULL;
+  }
+
+  if (config_read_layout(&rc, &layout) > 0) {
+    layout_clear(&layout);
+    rc_close(&rc);
+    return NULL;
+  }
+
+  unless ((intern.table = bindings_new(layout.zone_count * monitor_count))) {
+    layout_clear(&layout);
+    rc_close(&rc);
+    return NULL;
+  }
+  intern.table->layout = layout;
+
+  unless ((intern.named = calloc((size_t)intern.table->zone_count * EVENT_COUNT * MOD_COUNT, 1))) {
+    bindings_unref(intern.table);
+    rc_close(&rc);
+    return NULL;
+  }
+
+  // A [Settings] Helper goes in first: commands and zone helpers replace it
+  g = rc_group(&rc, "Settings");
+  for (m = 0; m < monitor_count; m++) {
+    if (!monitors[m].enabled) continue;
+
+    if ((helper = config_read_helper(&rc, g, &intern, m * layout.zone_count, layout.zone_count))) {
+      printf("Helper : %s (monitor: %s)\n", helper->line, monitors[m].name);
+    }
+  }
+
+  // Then the "Default" sections - these apply to all enabled monitors
+  for (i = 0; i < layout.zone_count; i++) {
+    if ((g = rc_group(&rc, layout_name(&layout, i))) < 0) continue;
+
+    // Apply default settings to all enabled monitors
+    for (m = 0; m < monitor_count; m++) {
+      if (!monitors[m].enabled) continue;
+
+      int base_idx = m * layout.zone_count;
+
+      for (k = rc.groups[g].first; k < rc.groups[g].first + rc.groups[g].count; k++) {
+        if ((command = config_read_command(&rc, g, &rc.entries[k], &intern, base_idx + i))) {
+          printf("Default %s %s : %s (monitor: %s)\n",
+                layout_name(&layout, i), rc.entries[k].key, command->line ? command->line : "", monitors[m].name);
+        }
+      }
+      if ((helper = config_read_helper(&rc, g, &intern, base_idx + i, 1))) {
+        printf("Default %s Helper : %s (monitor: %s)\n", layout_name(&layout, i), helper->line, monitors[m].name);
+      }
+    }
+  }
+
+  // Now process monitor-specific sections (overrides defaults)
+  for (m = 0; m < monitor_count; m++) {
+    if (!monitors[m].enabled) continue;
+
+    for (i = 0; i < layout.zone_count; i++) {
+      // Group name in format "MonitorName-TopLeft", etc.
+      char group_name[256];
+      int base_idx = m * layout.zone_count;
+
+      if (snprintf(group_name, sizeof(group_name), "%s-%s", monitors[m].name, layout_name(&layout, i)) >=
+          (int)sizeof(group_name)) continue;
+      if ((g = rc_group(&rc, group_name)) < 0) continue;
+
+      for (k = rc.groups[g].first; k < rc.groups[g].first + rc.groups[g].count; k++) {
+        if ((command = config_read_command(&rc, g, &rc.entries[k], &intern, base_idx + i))) {
+          printf("%s %s : %s (monitor: %s)\n",
+                layout_name(&layout, i), rc.entries[k].key, command->line ? command->line : "", monitors[m].name);
+        }
+      }
+      if ((helper = config_read_helper(&rc, g, &intern, base_idx + i, 1))) {
+        printf("%s Helper : %s (monitor: %s)\n", layout_name(&layout, i), helper->line, monitors[m].name);
+      }
+    }
+  }
+
+  // Gestures last: they refer to zones and monitors, not the other way round
+  errors = config_read_gestures(&rc, &intern);
+
+  /* Bad numbers and booleans of the bindings are counted as they are read */
+  errors += rc.errors;
+
+  free(intern.values);
+  free(intern.named);
+  rc_close(&rc);
+
+  if (errors) {
+    bindings_unref(intern.table);
+    return NULL;
+  }
+  return intern.table;
+}
+void
+fill_file(const char *file_path)
+{
+  FILE *fp;
+  int  i;
+
+  char* lines[] = {
+    "#fittsmonrc example\n",
+    "#volume control in the top right corner:\n\n",
+    "[TopRight]\n",
+    "WheelUp=amixer -q sset Master 2+\n",
+    "WheelDown=amixer -q sset Master 2-\n",
+    "RightButton=amixer -q sset Master toggle\n",
+    "LeftButton=xterm -C alsamixer\n\n\n",
+    "#Multi-monitor configuration example:\n",
+    "#[DP-0-TopLeft]\n",
+    "#LeftButton=notify-send \"Clicked on DP-0 Top Left\"\n\n",
+    "#[HDMI-0-BottomRight]\n",
+    "#RightButton=notify-send \"Clicked on HDMI-0 Bottom Right\"\n\n",
+    "#Available positions: Left, TopLeft, TopCenter, TopRight, Right, BottomRight, BottomCenter, BottomLeft\n",
+    "#Available events: LeftButton, RightButton, MiddleButton, WheelUp, WheelDown, WheelUpOnce, WheelDownOnce, Enter, Leave\n",
+    "#  WheelLeft, WheelRight, Button8, Button9, and buttons with modifiers: Shift+WheelUp, Ctrl+Alt+LeftButton\n",
+    "#Monitor-specific config format: [MonitorName-Position]\n\n",
+    "#Zone sizes in pixels or percent of the monitor, and extra zones:\n",
+    "#[Settings]\n",
+    "#CornerSize=12\n",
+    "#EdgeThickness=3\n",
+    "#EdgeLength=60%\n",
+    "#Zones=TopLeftThird\n\n",
+    "#The left third of the top edge:\n",
+    "#[TopLeftThird]\n",
+    "#X=0\n",
+    "#Y=0\n",
+    "#Width=33%\n",
+    "#Height=3\n"
+  };
+
+  fp = fopen(file_path, "wb");
+  if (fp == NULL) return;
+
+  for (i = 0; i < (int)ARRAY_LEN(lines); i++) fputs(lines[i], fp);
+
+  fclose (fp);
+}
+
+
+/* $XDG_CONFIG_HOME/fittsmon, else ~/.config/fittsmon. NULL if out of
+   memory. */
+static char *
+config_dir (void)
+{
+  const char *base = getenv("XDG_CONFIG_HOME");
+  const char *suffix = "/fittsmon";
+  char *dir;
+
+  unless (base && *base == '/') {
+    struct passwd *pw;
+
+    suffix = "/.config/fittsmon";
+    base = getenv("HOME");
+    unless (base && *base) base = (pw = getpwuid(getuid())) ? pw->pw_dir : "";
+  }
+
+  unless ((dir = malloc(strlen(base) + strlen(suffix) + 1))) return NULL;
+  sprintf(dir, "%s%s", base, suffix);
+  return dir;
+}
+
+/* Read fittsmonrc and install its bindings. Returns -1 if not even an
+   empty table could be installed. */
+int
+config_read ()
+{
+  struct str_bindings *table = NULL;
+  char *dir = config_dir();
+
+  /* check fittsmonrc in user directory */
+  if (dir && (config_file_path = malloc(strlen(dir) + sizeof("/fittsmonrc")))) {
+    sprintf(config_file_path, "%s/fittsmonrc", dir);
+    if (access(config_file_path, F_OK) < 0) {
+      mkdir(dir, 0777);
+      fill_file(config_file_path);
+      printf("Created a sample fittsmonrc for you in %s \n", config_file_path);
+    }
+  }
+  free(dir);
+
+  /* Start with no bindings rather than not at all. A table for the 8
+     positions alone installs unless memory runs out: they are there from
+     the start. */
+  if (config_file_path && (table = config_read_file(config_file_path)) && bindings_install(table) == 0) return 0;
+  if ((table = bindings_new(8 * monitor_count)) && bindings_install(table) == 0) return 0;
+
+  if (bindings) {
+    fprintf(stderr, "Keeping the previous configuration\n");
+    return 0;
+  }
+  fprintf(stderr, "Out of memory\n");
+  return -1;
+}
+
+/* Rebuild the binding table, e.g. after the file changed or a monitor was
+   enabled. On any error the current table stays in place. */
+void
+config_reload (void)
+{
+  struct str_bindings *table;
+
+  unless (config_file_path) return;
+
+  unless ((table = config_read_file(config_file_path))) {
+    fprintf(stderr, "Keeping the previous configuration\n");
+    return;
+  }
+
+  if (bindings_install(table) < 0) {
+    fprintf(stderr, "Keeping the previous configuration\n");
+    return;
+  }
+  printf("Reloaded %s\n", config_file_path);
+}
+
+/* Watch the config directory for fittsmonrc being rewritten or replaced.
+   Editors that save through a rename are caught by IN_MOVED_TO; writers
+   are only looked at once they close the file. Returns the fd to poll,
+   -1 if the watch could not be set up. */
+int
+config_watch (void)
+{
+  char *dir;
+
+  unless (config_file_path) return -1;
+  if (config_watch_fd >= 0) return config_watch_fd;
+
+  config_watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (config_watch_fd < 0) {
+    perror("inotify_init1");
+    return -1;
+  }
+
+  unless ((dir = strdup(config_file_path))) {
+    close(config_watch_fd);
+    config_watch_fd = -1;
+    return -1;
+  }
+  *strrchr(dir, '/') = '\0';
+  if (inotify_add_watch(config_watch_fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    fprintf(stderr, "Cannot watch %s for changes: %s\n", dir, strerror(errno));
+    close(config_watch_fd);
+    config_watch_fd = -1;
+  }
+  free(dir);
+
+  return config_watch_fd;
+}
+
+/* Drain the inotify fd and reload once if fittsmonrc was among the
+   changed files */
+void
+config_watch_handle (int fd, uint32_t events)
+{
+  char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+  int changed = 0;
+  ssize_t len;
+
+  while ((len = read(config_watch_fd, buf, sizeof(buf))) > 0) {
+    for (char *p = buf; p < buf + len; ) {
+      const struct inotify_event *ev = (const struct inotify_event *)p;
+
+      if (ev->len > 0 && strcmp(ev->name, "fittsmonrc") == 0) changed = 1;
+      p += sizeof(struct inotify_event) + ev->len;
+    }
+  }
+
+  if (changed) config_reload();
+}
@@ -0,0 +1,275 @@
+/**************************************************************************
+*
+* fittsmon : map mouse button events on screen corners to commands.
+*             Event dispatch and wheel burst coalescing.
+*
+* Copyright (C) 2009 Yasen Atanasov (yasen.atanasov@gmail.com)
+* Modified 2025 by Eric Bakker (linuxbirdtweets@duck.com)
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License version 2
+* as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**************************************************************************/
+
+
+/* INCLUDES */
+
+#include "fittsmon.h"
+
+#include <stdio.h>
+
+
+/* CONSTANTS/OPTIONS */
+
+/* Bursts pending at once; another one launches the oldest early */
+#define DISPATCH_BURSTS 16
+
+/* STRUCTS */
+
+/* A run of identical events waiting to be launched as one command. Each
+   zone, event and modifier set has a burst of its own, so the WheelUpOnce
+   of a press leaves the WheelUp burst it came with alone. Bursts launch
+   in the order their first events arrived; commands without Coalesce do
+   not wait for them. */
+struct str_burst {
+  int win;
+  int event;
+  int mods;
+  xcb_timestamp_t first_time; /* X server time of the first event */
+  long long first_dequeued;   /* CLOCK_MONOTONIC ns the first event was read at */
+  unsigned int count;
+  long long deadline;         /* CLOCK_MONOTONIC ms at which the burst is launched */
+};
+
+/* GLOBALS */
+
+static struct str_burst bursts[DISPATCH_BURSTS];   /* oldest first */
+static int burst_count = 0;
+
+/* implementations */
+
+static long long
+monotonic_ms (void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Queue an action for the launcher thread. Built-in actions only send a
+   message to the window manager and helper lines are a non-blocking
+   write, so both run right here. */
+static void
+dispatch_launch (const struct str_command *command, int win, int event, int mods, xcb_timestamp_t time,
+                 unsigned int count, long long dequeued)
+{
+  struct str_action action;
+
+  stats_count(STATS_LAUNCHED, event, 1);
+
+  if (command->internal) {
+    ewmh_run(command->internal, time, count);
+    return;
+  }
+  if (command->helper) {
+    helper_write(command, win, event, mods, time, count);
+    return;
+  }
+
+  action.command = command;
+  action.win = win;
+  action.event = event;
+  action.time = time;
+  action.count = count;
+  action.dequeued = dequeued;
+  action.table = bindings;
+  action.envp = displays[monitors[win / zones_per_monitor].display].environ;
+  launcher_push(&action);
+}
+
+/* Take a token from the zone event's bucket. Buckets refill at the
+   binding's Rate, measured in X server time so clock changes and suspend
+   cannot disturb them. Returns 0 when the launch is over the limit. */
+static int
+dispatch_allow (int win, int event, const struct str_command *command, xcb_timestamp_t time)
+{
+  struct str_bucket *bucket = &window_options[win].buckets[event];
+
+  unless (command->rate > 0) return 1;
+
+  bucket->used -= (xcb_timestamp_t)(time - bucket->stamp) * command->rate / 1000;
+  if (bucket->used < 0) bucket->used = 0;
+  bucket->stamp = time;
+
+  if (bucket->used + 1 > command->burst) return 0;
+
+  bucket->used += 1;
+  return 1;
+}
+
+/* Launch the n oldest bursts with their repeat counts */
+static void
+dispatch_launch_bursts (int n)
+{
+  for (int i = 0; i < n; i++) {
+    const struct str_burst *burst = &bursts[i];
+
+    dispatch_launch(&get_cmd(burst->win, burst->event, burst->mods), burst->win, burst->event, burst->mods,
+                    burst->first_time, burst->count, burst->first_dequeued);
+  }
+  burst_count -= n;
+  memmove(bursts, bursts + n, burst_count * sizeof(struct str_burst));
+}
+
+/* Launch the pending bursts, if any */
+void
+dispatch_flush (void)
+{
+  dispatch_launch_bursts(burst_count);
+}
+
+/* Format an event as the one-line record helpers and broadcast
+   subscribers read: zone, event with its modifiers (Shift+WheelUp),
+   monitor, X time and repeat count. Returns its length, -1 if it does not
+   fit: a line cut short would run into the next one. */
+int
+dispatch_format (char *buf, size_t size, int win, int event, int mods, xcb_timestamp_t time,
+                 unsigned int count)
+{
+  char held[32] = "";
+  int len;
+
+  for (int i = 0; i < 4; i++) {
+    if (mods & (1 << i)) strcat(strcat(held, modifier_names[i]), "+");
+  }
+  len = snprintf(buf, size, "%s %s%s %s %u %u\n", zone_name(win), held, event_names[event],
+                 monitors[win / zones_per_monitor].name, (unsigned int)time, count);
+
+  return len < (int)size ? len : -1;
+}
+
+/* Take an event on a zone. Bindings with a Dwell time wait for the
+   pointer to stay that long; the rest go on to dispatch_fire at once.
+   Gestures see the event after its own binding, so they never delay it. */
+void
+dispatch_event (int win, int event, int mods, xcb_timestamp_t time)
+{
+  const struct str_command *command = &get_cmd(win, event, mods);
+  long long now = stats_now_ns();
+  int symbol;
+
+  stats_dequeued(win, event, time, now);
+  broadcast_event(win, event, mods, time, 1);
+
+  /* Whatever was waiting for the pointer to stay is off */
+  if (event == Leave) dwell_cancel(win, 1);
+
+  if (command_bound(command)) {
+    if (command->dwell_ms) dwell_add(win, event, mods, time, command->dwell_ms);
+    else dispatch_fire(win, event, mods, time, now);
+  }
+
+  if ((symbol = gesture_symbol(bindings, win, event))) gesture_feed(symbol, time, now);
+}
+
+/* Launch the command bound to an event on a zone, if any and if its rate
+   limit allows. Bindings with a Coalesce window collect identical events,
+   measured in X server time from the first one, and launch once with the
+   count as %n. */
+void
+dispatch_fire (int win, int event, int mods, xcb_timestamp_t time, long long now)
+{
+  const struct str_command *command = &get_cmd(win, event, mods);
+  long long start = trace_now();
+  struct str_burst *burst;
+
+  /* A dwelling event may outlive its binding */
+  unless (command_bound(command)) return;
+
+  for (int i = 0; i < burst_count; i++) {
+    burst = &bursts[i];
+    unless (burst->win == win && burst->event == event && burst->mods == mods) continue;
+
+    if ((xcb_timestamp_t)(time - burst->first_time) <= command->coalesce_ms) {
+      stats_count(STATS_COALESCED, event, 1);
+      burst->count++;
+      trace_span(TRACE_THROTTLE, start, win, event, TRACE_COALESCED);
+      return;
+    }
+    /* Its window is over: it goes, after the bursts that came before it */
+    dispatch_launch_bursts(i + 1);
+    break;
+  }
+
+  /* A burst is one launch: only its first event is rate limited */
+  unless (dispatch_allow(win, event, command, time)) {
+    stats_count(STATS_LIMITED, event, 1);
+    trace_span(TRACE_THROTTLE, start, win, event, TRACE_LIMITED);
+    return;
+  }
+  trace_span(TRACE_THROTTLE, start, win, event, command->coalesce_ms ? TRACE_HELD : TRACE_PASSED);
+
+  unless (command->coalesce_ms) {
+    dispatch_launch(command, win, event, mods, time, 1, now);
+    return;
+  }
+
+  if (burst_count == DISPATCH_BURSTS) dispatch_launch_bursts(1);
+
+  burst = &bursts[burst_count++];
+  burst->win = win;
+  burst->event = event;
+  burst->mods = mods;
+  burst->first_time = time;
+  burst->first_dequeued = now;
+  burst->count = 1;
+  burst->deadline = monotonic_ms() + command->coalesce_ms;
+}
+
+/* Launch a gesture's command, reported as its last event */
+void
+dispatch_gesture (const struct str_command *command, int win, int event, xcb_timestamp_t time,
+                  long long dequeued)
+{
+  /* Commands still start in the order their events arrived */
+  dispatch_flush();
+  dispatch_launch(command, win, event, 0, time, 1, dequeued);
+}
+
+/* Milliseconds until the next burst is due, -1 if nothing is pending */
+int
+dispatch_timeout (void)
+{
+  long long left, due;
+
+  unless (burst_count) return -1;
+
+  due = bursts[0].deadline;
+  for (int i = 1; i < burst_count; i++) {
+    if (bursts[i].deadline < due) due = bursts[i].deadline;
+  }
+  left = due - monotonic_ms();
+  return left > 0 ? (int)left : 0;
+}
+
+/* Launch the bursts whose window has closed, and the ones older than them */
+void
+dispatch_expire (void)
+{
+  long long now = monotonic_ms();
+  int last = -1;
+
+  for (int i = 0; i < burst_count; i++) {
+    if (now >= bursts[i].deadline) last = i;
+  }
+  if (last >= 0) dispatch_launch_bursts(last + 1);
+}
@@ -0,0 +1,182 @@
+/**************************************************************************
+*
+* fittsmon : map mouse button events on screen corners to commands.
+*             X displays and screens served by one process.
+*
+* Copyright (C) 2009 Yasen Atanasov (yasen.atanasov@gmail.com)
+* Modified 2025 by Eric Bakker (linuxbirdtweets@duck.com)
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License version 2
+* as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**************************************************************************/
+
+/*
+ * Every --display adds an X screen. Each screen has its own monitors and
+ * zones. fittsmonrc is read once and its binding table covers the zones of
+ * all of them. Screens of the same X server (":0.0" and ":0.1" on a
+ * Zaphod setup) share one connection. Each connection is one fd in the
+ * event loop, so another seat costs a connection and its windows, not a
+ * process.
+ *
+ * Monitors of the first display keep their RandR names. Those of the
+ * others are named after their display, ":1/HDMI-0", so fittsmonrc can
+ * tell them apart. Commands bound on a display's zones start with DISPLAY
+ * set to it.
+ */
+
+
+/* INCLUDES */
+
+#include "fittsmon.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+extern char **environ;
+
+
+/* GLOBALS */
+
+struct str_display *displays = NULL;
+int display_count = 0;
+
+/* implementations */
+
+/* A copy of the environment with DISPLAY=name. Built once per display, so
+   the launcher thread can use it without locking. */
+static char **
+display_environ (const char *name)
+{
+  size_t count = 0, n = 0;
+  char **env;
+
+  while (environ[count]) count++;
+
+  unless ((env = malloc((count + 2) * sizeof(char *)))) return NULL;
+  unless ((env[n] = malloc(strlen(name) + sizeof("DISPLAY=")))) {
+    free(env);
+    return NULL;
+  }
+  sprintf(env[n++], "DISPLAY=%s", name);
+
+  for (size_t i = 0; i < count; i++) {
+    unless (strncmp(environ[i], "DISPLAY=", 8) == 0) env[n++] = environ[i];
+  }
+  env[n] = NULL;
+  return env;
+}
+
+/* Connect to the screen a display name stands for, NULL for $DISPLAY. A
+   screen of an X server already connected to shares its connection.
+   Returns the display's index, -1 if it cannot be reached. */
+int
+display_add (const char *name)
+{
+  struct str_display *display, *grown;
+  char *host = NULL;
+  int number = 0, screen_number = 0, shared = -1;
+
+  if (name && !xcb_parse_display(name, &host, &number, &screen_number)) {
+    fprintf(stderr, "Error: '%s' is not a display name\n", name);
+    return -1;
+  }
+
+  for (int d = 0; name && d < display_count; d++) {
+    unless (strcmp(displays[d].host, host) == 0 && displays[d].number == number) continue;
+    if (displays[d].screen_number == screen_number) {
+      fprintf(stderr, "Error: Display %s is given twice\n", name);
+      free(host);
+      return -1;
+    }
+    shared = d;
+  }
+
+  unless ((grown = realloc(displays, (display_count + 1) * sizeof(struct str_display)))) {
+    free(host);
+    return -1;
+  }
+  displays = grown;
+  display = &displays[display_count];
+  memset(display, 0, sizeof(*display));
+
+  if (shared >= 0) {
+    display->connection = displays[shared].connection;
+  } else {
+    display->connection = xcb_connect(name, name ? NULL : &screen_number);
+    if (xcb_connection_has_error(display->connection)) {
+      fprintf(stderr, "Failed to connect to X server %s\n", name ? name : "");
+      xcb_disconnect(display->connection);
+      free(host);
+      return -1;
+    }
+  }
+
+  xcb_screen_iterator_t it = xcb_setup_roots_iterator(xcb_get_setup(display->connection));
+  for (int s = 0; s < screen_number && it.rem; s++) xcb_screen_next(&it);
+  unless (it.rem) {
+    fprintf(stderr, "Error: Display %s has no screen %d\n", name ? name : "", screen_number);
+    if (shared < 0) xcb_disconnect(display->connection);
+    free(host);
+    return -1;
+  }
+
+  display->name = name;
+  display->host = host;
+  display->number = number;
+  display->screen_number = screen_number;
+  display->screen = it.data;
+  display->fd = xcb_get_file_descriptor(display->connection);
+  display->randr_event_base = -1;
+
+  /* Commands started for its zones go to this display, whatever DISPLAY
+     fittsmon itself was started with */
+  if (name && !(display->environ = display_environ(name))) {
+    fprintf(stderr, "Warning: Out of memory, commands on %s start with fittsmon's DISPLAY\n", name);
+  }
+
+  return display_count++;
+}
+
+/* Is display d the first of those sharing its connection */
+int
+display_owns_connection (int d)
+{
+  for (int e = 0; e < d; e++) {
+    if (displays[e].connection == displays[d].connection) return 0;
+  }
+  return 1;
+}
+
+/* Prefix the names of a display's monitors with the display, except on
+   the first display, and mark them as its own */
+void
+display_name_monitors (int d, MonitorInfo *list, int count)
+{
+  for (int i = 0; i < count; i++) {
+    list[i].display = d;
+    if (d == 0) continue;
+
+    char name[sizeof(list[i].name)];
+
+    snprintf(name, sizeof(name), "%s/%s", displays[d].name, list[i].name);
+    memcpy(list[i].name, name, sizeof(name));
+  }
+}
+
+/* Close every connection, once */
+void
+displays_disconnect (void)
+{
+  for (int d = 0; d < display_count; d++) {
+    if (display_owns_connection(d)) xcb_disconnect(displays[d].connection);
+  }
+}
@@ -0,0 +1,175 @@
+/**************************************************************************
+*
+* fittsmon : map mouse button events on screen corners to commands.
+*             Dwell: bindings that wait for the pointer to stay put.
+*
+* Copyright (C) 2009 Yasen Atanasov (yasen.atanasov@gmail.com)
+* Modified 2025 by Eric Bakker (linuxbirdtweets@duck.com)
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License version 2
+* as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**************************************************************************/
+
+/*
+ * An event whose binding has Event.Dwell=ms is held here instead of being
+ * launched. If the pointer leaves the zone within ms the event is dropped;
+ * otherwise it goes on to rate limiting, coalescing and launch as if it
+ * had just arrived.
+ *
+ * Pending events sit in a small table. One timerfd, set to the earliest
+ * deadline, wakes the event loop's poll when something is due, so there is
+ * no thread and no polling in between.
+ */
+
+
+/* INCLUDES */
+
+#include "fittsmon.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+
+/* CONSTANTS/OPTIONS */
+
+/* Events waiting at once; the pointer is only ever in a zone or two */
+#define DWELL_SLOTS 32
+
+/* STRUCTS */
+
+struct str_dwell {
+  int win;
+  int event;
+  int mods;
+  xcb_timestamp_t time;  /* X server time the event is due at */
+  long long deadline;    /* CLOCK_MONOTONIC ns the event is due at */
+};
+
+/* GLOBALS */
+
+static int dwell_fd = -1;
+static struct str_dwell pending[DWELL_SLOTS];
+static int pending_count = 0;
+static long long armed = 0;  /* deadline the timer is set to, 0 if disarmed */
+
+/* implementations */
+
+/* Set the timer to the earliest deadline, or disarm it */
+static void
+dwell_arm (void)
+{
+  struct itimerspec spec;
+  long long deadline = 0;
+
+  for (int i = 0; i < pending_count; i++) {
+    if (!deadline || pending[i].deadline < deadline) deadline = pending[i].deadline;
+  }
+  if (deadline == armed) return;
+
+  memset(&spec, 0, sizeof(spec));
+  spec.it_value.tv_sec = deadline / 1000000000;
+  spec.it_value.tv_nsec = deadline % 1000000000;
+  timerfd_settime(dwell_fd, TFD_TIMER_ABSTIME, &spec, NULL);
+  armed = deadline;
+}
+
+/* Create the timer. Returns the fd for the event loop to poll, -1 if
+   there is none, in which case dwelling events launch at once. */
+int
+dwell_init (void)
+{
+  if (dwell_fd >= 0) return dwell_fd;
+
+  dwell_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (dwell_fd < 0) perror("timerfd_create");
+  return dwell_fd;
+}
+
+/* Hold an event until ms have passed */
+void
+dwell_add (int win, int event, int mods, xcb_timestamp_t time, unsigned int ms)
+{
+  if (dwell_fd < 0) {
+    dispatch_fire(win, event, mods, time, stats_now_ns());
+    return;
+  }
+  if (pending_count == DWELL_SLOTS) {
+    fprintf(stderr, "Warning: Too many dwelling events, dropping %s\n", event_names[event]);
+    return;
+  }
+
+  pending[pending_count].win = win;
+  pending[pending_count].event = event;
+  pending[pending_count].mods = mods;
+  pending[pending_count].time = time + ms;
+  pending[pending_count].deadline = stats_now_ns() + (long long)ms * 1000000;
+  pending_count++;
+  dwell_arm();
+}
+
+/* Drop the events waiting on zones first_zone..first_zone+zone_count-1:
+   the pointer left, or the zones are going away */
+void
+dwell_cancel (int first_zone, int zone_count)
+{
+  int i, j;
+
+  for (i = j = 0; i < pending_count; i++) {
+    if (pending[i].win >= first_zone && pending[i].win < first_zone + zone_count) {
+      stats_count(STATS_DWELL_CANCELLED, pending[i].event, 1);
+      continue;
+    }
+    pending[j++] = pending[i];
+  }
+  if (j == pending_count) return;
+
+  pending_count = j;
+  dwell_arm();
+}
+
+/* Pass on every event that is due, or every event waiting if all is
+   set: --replay uses that once the pointer has nowhere left to go */
+void
+dwell_expire (int all)
+{
+  struct str_dwell due[DWELL_SLOTS];
+  long long now;
+  int due_count = 0;
+  int i, j;
+
+  unless (pending_count) return;
+
+  now = stats_now_ns();
+  for (i = j = 0; i < pending_count; i++) {
+    if (all || pending[i].deadline <= now) due[due_count++] = pending[i];
+    else pending[j++] = pending[i];
+  }
+  pending_count = j;
+  armed = 0;
+  dwell_arm();
+
+  for (i = 0; i < due_count; i++) dispatch_fire(due[i].win, due[i].event, due[i].mods, due[i].time, now);
+}
+
+/* The timer fired */
+void
+dwell_handle (int fd, uint32_t events)
+{
+  uint64_t expirations;
+
+  /* Nothing to read when a cancel disarmed it in the meantime */
+  if (read(dwell_fd, &expirations, sizeof(expirations)) < 0) return;
+
+  dwell_expire(0);
+}
@@ -0,0 +1,266 @@
+/**************************************************************************
+*
+* fittsmon : map mouse button events on screen corners to commands.
+*             Built-in @actions sent as EWMH client messages.
+*
+* Copyright (C) 2009 Yasen Atanasov (yasen.atanasov@gmail.com)
+* Modified 2025 by Eric Bakker (linuxbirdtweets@duck.com)
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License version 2
+* as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**************************************************************************/
+
+/*
+ * Bindings whose command starts with '@' name a built-in action that is
+ * carried out on fittsmon's own X connection instead of spawning wmctrl
+ * or xdotool. The window manager state these actions need (current
+ * desktop, desktop count, showing-desktop flag, active window) is read
+ * once at startup and then kept up to date from PropertyNotify events on
+ * the root window, so running an action never waits for a reply. Neither
+ * does the event path: a change is re-read with a request whose reply
+ * ewmh_poll picks up once the event queue is drained.
+ */
+
+
+/* INCLUDES */
+
+#include "fittsmon.h"
+
+#include <xcb/xcbext.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+/* CONSTANTS/OPTIONS */
+
+enum eAtoms {
+  NET_CURRENT_DESKTOP, NET_NUMBER_OF_DESKTOPS, NET_SHOWING_DESKTOP, NET_ACTIVE_WINDOW,
+  NET_CLOSE_WINDOW, WM_CHANGE_STATE, ATOM_COUNT
+};
+
+static const char *atom_names[ATOM_COUNT] = {
+  "_NET_CURRENT_DESKTOP", "_NET_NUMBER_OF_DESKTOPS", "_NET_SHOWING_DESKTOP", "_NET_ACTIVE_WINDOW",
+  "_NET_CLOSE_WINDOW", "WM_CHANGE_STATE"
+};
+
+/* Action names as written in fittsmonrc, indexed by eInternalActions */
+static const char *action_names[] = {
+  NULL, "@desktop-next", "@desktop-prev", "@show-desktop", "@close-window", "@minimize-window"
+};
+
+#define ICCCM_ICONIC_STATE 3
+#define EWMH_SOURCE_PAGER  2
+
+/* GLOBALS */
+
+static xcb_connection_t *ewmh_connection = NULL;
+static xcb_window_t ewmh_root;
+static xcb_atom_t atoms[ATOM_COUNT];
+
+/* Window manager state mirrored from the root window properties */
+static uint32_t current_desktop;
+static uint32_t number_of_desktops;
+static uint32_t showing_desktop;
+static xcb_window_t active_window;
+
+/* Re-reads in flight, per property; again: it changed once more meanwhile */
+static xcb_get_property_cookie_t refresh_cookies[4];
+static char refresh_pending[4];
+static char refresh_again[4];
+
+/* implementations */
+
+/* Map an @action name to its id, 0 if there is no such action */
+int
+ewmh_action_parse (const char *name)
+{
+  for (unsigned int i = 1; i < sizeof(action_names) / sizeof(action_names[0]); i++) {
+    if (strcmp(name, action_names[i]) == 0) return i;
+  }
+  return 0;
+}
+
+static uint32_t
+ewmh_reply_cardinal (xcb_get_property_reply_t *reply, uint32_t fallback)
+{
+  uint32_t value = fallback;
+
+  if (reply && reply->format == 32 && xcb_get_property_value_length(reply) >= 4) {
+    value = *(uint32_t *)xcb_get_property_value(reply);
+  }
+  free(reply);
+  return value;
+}
+
+static xcb_get_property_cookie_t
+ewmh_request (int atom)
+{
+  return xcb_get_property(ewmh_connection, 0, ewmh_root, atoms[atom], XCB_ATOM_ANY, 0, 1);
+}
+
+/* Intern the atoms and read the window manager state, each stage with
+   all of its requests in flight at once, then follow changes to it */
+void
+ewmh_init (xcb_connection_t *connection, xcb_screen_t *screen)
+{
+  xcb_intern_atom_cookie_t atom_cookies[ATOM_COUNT];
+  xcb_get_property_cookie_t cookies[4];
+  uint32_t mask = XCB_EVENT_MASK_PROPERTY_CHANGE;
+  int i;
+
+  ewmh_connection = connection;
+  ewmh_root = screen->root;
+
+  for (i = 0; i < ATOM_COUNT; i++) {
+    atom_cookies[i] = xcb_intern_atom(connection, 0, strlen(atom_names[i]), atom_names[i]);
+  }
+  for (i = 0; i < ATOM_COUNT; i++) {
+    xcb_intern_atom_reply_t *reply = xcb_intern_atom_reply(connection, atom_cookies[i], NULL);
+
+    atoms[i] = reply ? reply->atom : XCB_ATOM_NONE;
+    free(reply);
+  }
+
+  /* Select first so no change slips in between reading and watching */
+  xcb_change_window_attributes(connection, ewmh_root, XCB_CW_EVENT_MASK, &mask);
+
+  for (i = 0; i < 4; i++) cookies[i] = ewmh_request(i);
+  current_desktop = ewmh_reply_cardinal(xcb_get_property_reply(connection, cookies[NET_CURRENT_DESKTOP], NULL), 0);
+  number_of_desktops = ewmh_reply_cardinal(xcb_get_property_reply(connection, cookies[NET_NUMBER_OF_DESKTOPS], NULL), 0);
+  showing_desktop = ewmh_reply_cardinal(xcb_get_property_reply(connection, cookies[NET_SHOWING_DESKTOP], NULL), 0);
+  active_window = ewmh_reply_cardinal(xcb_get_property_reply(connection, cookies[NET_ACTIVE_WINDOW], NULL), XCB_WINDOW_NONE);
+}
+
+static uint32_t *
+ewmh_value (int atom)
+{
+  switch (atom) {
+    case NET_CURRENT_DESKTOP:    return &current_desktop;
+    case NET_NUMBER_OF_DESKTOPS: return &number_of_desktops;
+    case NET_SHOWING_DESKTOP:    return &showing_desktop;
+    default:                     return &active_window;
+  }
+}
+
+static void
+ewmh_refresh (int atom)
+{
+  refresh_cookies[atom] = ewmh_request(atom);
+  refresh_pending[atom] = 1;
+  refresh_again[atom] = 0;
+}
+
+/* Re-read the mirrored state when the window manager changes it */
+void
+ewmh_property_notify (xcb_property_notify_event_t *event)
+{
+  int i;
+
+  if (event->window != ewmh_root) return;
+
+  for (i = 0; i < 4 && atoms[i] != event->atom; i++)
+    ;
+  if (i == 4) return;
+
+  /* The reply in flight is from before this change */
+  if (refresh_pending[i]) refresh_again[i] = 1;
+  else if (event->state == XCB_PROPERTY_DELETE) *ewmh_value(i) = 0;
+  else ewmh_refresh(i);
+}
+
+/* Pick up the re-reads that are in. Called after the event queue is
+   drained. */
+void
+ewmh_poll (void)
+{
+  for (int i = 0; i < 4; i++) {
+    xcb_get_property_reply_t *reply = NULL;
+    xcb_generic_error_t *error = NULL;
+
+    unless (refresh_pending[i]) continue;
+    unless (xcb_poll_for_reply(ewmh_connection, refresh_cookies[i].sequence, (void **)&reply, &error)) continue;
+
+    refresh_pending[i] = 0;
+    free(error);
+    if (refresh_again[i]) {
+      free(reply);
+      ewmh_refresh(i);
+      continue;
+    }
+    *ewmh_value(i) = ewmh_reply_cardinal(reply, 0);
+  }
+}
+
+static void
+ewmh_send (xcb_window_t window, int atom, uint32_t d0, uint32_t d1, uint32_t d2)
+{
+  xcb_client_message_event_t event;
+
+  memset(&event, 0, sizeof(event));
+  event.response_type = XCB_CLIENT_MESSAGE;
+  event.format = 32;
+  event.window = window;
+  event.type = atoms[atom];
+  event.data.data32[0] = d0;
+  event.data.data32[1] = d1;
+  event.data.data32[2] = d2;
+
+  xcb_send_event(ewmh_connection, 0, ewmh_root,
+                 XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY | XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT,
+                 (const char *)&event);
+}
+
+/* Carry out a built-in action. count is the number of events it stands
+   for: a coalesced wheel burst moves that many desktops. */
+void
+ewmh_run (int action, xcb_timestamp_t time, unsigned int count)
+{
+  int64_t target;
+
+  unless (ewmh_connection) return;
+
+  switch (action) {
+    case ACTION_DESKTOP_NEXT:
+    case ACTION_DESKTOP_PREV:
+      unless (number_of_desktops) {
+        fprintf(stderr, "Warning: %s: the window manager does not publish _NET_NUMBER_OF_DESKTOPS\n",
+                action_names[action]);
+        return;
+      }
+      target = (int64_t)current_desktop + (action == ACTION_DESKTOP_NEXT ? 1 : -1) * (int64_t)count;
+      target %= number_of_desktops;
+      if (target < 0) target += number_of_desktops;
+
+      ewmh_send(ewmh_root, NET_CURRENT_DESKTOP, (uint32_t)target, time, 0);
+      /* Assume it worked, so events ahead of the PropertyNotify add up */
+      current_desktop = (uint32_t)target;
+      break;
+
+    case ACTION_SHOW_DESKTOP:
+      if (count % 2 == 0) return;
+      showing_desktop = !showing_desktop;
+      ewmh_send(ewmh_root, NET_SHOWING_DESKTOP, showing_desktop, 0, 0);
+      break;
+
+    case ACTION_CLOSE_WINDOW:
+      unless (active_window) return;
+      ewmh_send(active_window, NET_CLOSE_WINDOW, time, EWMH_SOURCE_PAGER, 0);
+      break;
+
+    case ACTION_MINIMIZE_WINDOW:
+      unless (active_window) return;
+      ewmh_send(active_window, WM_CHANGE_STATE, ICCCM_ICONIC_STATE, 0, 0);
+      break;
+  }
+}
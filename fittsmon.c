@@ -22,238 +22,313 @@
 
 /* INCLUDES */
 
-#include <xcb/xcb.h>
+#include "fittsmon.h"
+
 #include <xcb/randr.h>  // Added for RandR extension to handle monitors
-#include <glib/gstdio.h>
 
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>   /* getenv(), etc. */
 #include <time.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
 
 
-/* MACROS */
+/*GLOBALS*/
+struct str_window_options *window_options = NULL;  // zones_per_monitor zones per monitor slot
+int zones_per_monitor = 8;  // the 8 positions until fittsmonrc names more
+MonitorInfo *monitors = NULL;
+int monitor_count = 0;
+static int monitor_capacity = 0;  // slots allocated in monitors and window_options
 
-#define str_defined(str) ( (str && strlen(str) > 0) ? 1 : 0 )
-#define unless(a)        if ( ! (a) )
-#define get_cmd(win,cmd) window_options[win].commands[cmd]
+/* Set once the zone windows are first created; from then on zones a
+   reloaded fittsmonrc adds, moves or removes get or lose their windows */
+static int windows_created = 0;
 
-/* CONSTANTS/OPTIONS */
+/* (connection, XID) -> zone index, open addressing with linear probing.
+   The size is a power of two, at least twice the zone count so probes
+   stay short. */
+static struct str_zone_map_entry *zone_map = NULL;
+static unsigned int zone_map_mask = 0;
 
-/* Screen Corners */
-enum eScreenCorners {
-  TopLeft, TopCenter, TopRight, Right, BottomRight, BottomCenter, BottomLeft, Left
-};
+/* X events handled per batch */
+#define SERVER_BATCH_SIZE 64
 
-/* Mouse button indexes for commands */
-enum eMouseButtons {
-  LeftButton, MiddleButton, RightButton, WheelUp, WheelDown, WheelUpOnce, WheelDownOnce, Enter, Leave
-};
+/* epoll events taken per wakeup */
+#define SERVER_EPOLL_EVENTS 16
 
-/* XCB mouse button indexes */
-enum eXCBButtonIndexes {
-  LEFT_BUTTON=1, MIDDLE_BUTTON, RIGHT_BUTTON, WHEEL_UP_BUTTON, WHEEL_DOWN_BUTTON
+/* The events a press of each X button dispatches, -1 for none */
+static const signed char button_events[10][2] = {
+  { -1, -1 },
+  { LeftButton, -1 }, { MiddleButton, -1 }, { RightButton, -1 },
+  { WheelUp, WheelUpOnce }, { WheelDown, WheelDownOnce },
+  { WheelLeft, -1 }, { WheelRight, -1 }, { Button8, -1 }, { Button9, -1 }
 };
 
-/* Maximum number of monitors */
-#define MAX_MONITORS 8
-
-/* STRUCTS */
-struct str_window_options {
-  char enabled;
-  int x;
-  int y;
-  int h;
-  int w;
-  char commands[9][200];
-  xcb_window_t xcb_window; /* pointer to the newly created window.      */
-  time_t last_time_up; /* last time a wheel event on a corner has been made */
-  time_t last_time_down; /* last time a wheel event on a corner has been made */
-  char monitor_name[32]; /* The name of the monitor this window belongs to */
+/* A file descriptor the event loop waits on */
+struct str_watch {
+  void (*handle)(int fd, uint32_t events);
 };
 
-/* Monitor info struct */
-typedef struct {
-    int x;
-    int y;
-    int width;
-    int height;
-    int primary;
-    char name[32];
-    int enabled;  // Flag to indicate if this monitor is enabled by user args
-} MonitorInfo;
+/* The event loop's epoll set, and the handler of each fd in it */
+static int server_epoll_fd = -1;
+static struct str_watch *watches = NULL;
+static int watch_capacity = 0;
 
-/*GLOBALS*/
-struct str_window_options window_options[8 * MAX_MONITORS];  // 8 zones per monitor, up to MAX_MONITORS
-MonitorInfo monitors[MAX_MONITORS];
-int monitor_count = 0;
+/* --windowless: zones are found by pointer position, see pointer.c */
+static int windowless = 0;
 
-/* function prototypes */
-int  can_execute (const int corner, const int direction);
-int  is_safe_command (const char *cmd);
-void config_read ();
-void config_read_file (const char *file_path);
-void fill_file(const char *file_path);
-void init_options (int monitor_index);
-void server_create_windows(xcb_connection_t *connection, xcb_screen_t *screen);
-int  server_find_window(xcb_window_t win);
-void server_event_loop (xcb_connection_t *connection);
-int  get_all_monitors(xcb_connection_t *connection, xcb_screen_t *screen);
-int  enable_monitor_by_name(const char *name);
-void print_monitor_list();
+/* Monitor names given on the command line, empty for "primary only" */
+static char **requested_monitors = NULL;
+static int requested_count = 0;
 
 /* implementations */
 
-/* Get all monitors connected to the system */
-int get_all_monitors(xcb_connection_t *connection, xcb_screen_t *screen) {
+/* Use the whole screen as a single monitor */
+static int
+monitors_fallback(MonitorInfo **listp, xcb_screen_t *screen)
+{
+    MonitorInfo *list = *listp = calloc(1, sizeof(MonitorInfo));
+    
+    if (!list) return 0;
+    list[0].x = 0;
+    list[0].y = 0;
+    list[0].width = screen->width_in_pixels;
+    list[0].height = screen->height_in_pixels;
+    list[0].primary = 1;
+    list[0].enabled = 1;
+    list[0].connected = 1;
+    strncpy(list[0].name, "default", sizeof(list[0].name) - 1);
+    
+    return 1;  // We have one monitor
+}
+
+/* Fill in one monitor list entry and log it */
+static void
+monitor_add(MonitorInfo *list, int index, const char *name, int name_len, int x, int y, int width, int height, int primary)
+{
+    list[index].x = x;
+    list[index].y = y;
+    list[index].width = width;
+    list[index].height = height;
+    list[index].primary = primary;
+    list[index].enabled = 0;  // By default, no monitor is enabled
+    list[index].connected = 1;
+    
+    // Copy monitor name (with size limit)
+    size_t max_len = sizeof(list[index].name) - 1;
+    size_t copy_len = (name_len < (int)max_len) ? (size_t)name_len : max_len;
+    strncpy(list[index].name, name, copy_len);
+    list[index].name[copy_len] = '\0';  // Ensure null termination
+    
+    printf("Found monitor: %s (%dx%d at %d,%d) %s\n", 
+        list[index].name, 
+        list[index].width, 
+        list[index].height,
+        list[index].x, 
+        list[index].y,
+        list[index].primary ? "[Primary]" : "");
+}
+
+/* RandR 1.5: every logical monitor in one request. Tiled panels that
+   span several outputs come back as a single monitor. The monitor name
+   atoms are resolved with all requests in flight at once. */
+static int
+get_monitors_randr15(xcb_connection_t *connection, xcb_screen_t *screen, MonitorInfo **listp)
+{
     int count = 0;
     
-    // Check if RandR extension is available
-    const xcb_query_extension_reply_t *extension_reply = xcb_get_extension_data(connection, &xcb_randr_id);
-    if (!extension_reply || !extension_reply->present) {
-        printf("RandR extension not available, using whole screen as one monitor\n");
-        
-        // Create a fallback monitor entry for the whole screen
-        monitors[0].x = 0;
-        monitors[0].y = 0;
-        monitors[0].width = screen->width_in_pixels;
-        monitors[0].height = screen->height_in_pixels;
-        monitors[0].primary = 1;
-        monitors[0].enabled = 1;
-        strncpy(monitors[0].name, "default", sizeof(monitors[0].name) - 1);
-        
-        return 1;  // We have one monitor
+    xcb_randr_get_monitors_reply_t *mon_reply = xcb_randr_get_monitors_reply(connection,
+        xcb_randr_get_monitors(connection, screen->root, 1), NULL);
+    if (!mon_reply) return 0;
+    
+    int n = xcb_randr_get_monitors_monitors_length(mon_reply);
+    xcb_get_atom_name_cookie_t name_cookies[n > 0 ? n : 1];
+    MonitorInfo *list = *listp = calloc(n > 0 ? n : 1, sizeof(MonitorInfo));
+    xcb_randr_monitor_info_iterator_t it = xcb_randr_get_monitors_monitors_iterator(mon_reply);
+    
+    for (int i = 0; it.rem; i++, xcb_randr_monitor_info_next(&it)) {
+        name_cookies[i] = xcb_get_atom_name(connection, it.data->name);
     }
     
-    // Check RandR version
-    xcb_randr_query_version_cookie_t version_cookie = xcb_randr_query_version(connection, 1, 5);
-    xcb_randr_query_version_reply_t *version_reply = xcb_randr_query_version_reply(connection, version_cookie, NULL);
-    if (!version_reply) {
-        printf("Failed to get RandR version, using whole screen\n");
+    it = xcb_randr_get_monitors_monitors_iterator(mon_reply);
+    for (int i = 0; it.rem; i++, xcb_randr_monitor_info_next(&it)) {
+        if (!list) {
+            xcb_discard_reply(connection, name_cookies[i].sequence);
+            continue;
+        }
         
-        // Create a fallback monitor entry
-        monitors[0].x = 0;
-        monitors[0].y = 0;
-        monitors[0].width = screen->width_in_pixels;
-        monitors[0].height = screen->height_in_pixels;
-        monitors[0].primary = 1;
-        monitors[0].enabled = 1;
-        strncpy(monitors[0].name, "default", sizeof(monitors[0].name) - 1);
+        xcb_get_atom_name_reply_t *name_reply = xcb_get_atom_name_reply(connection, name_cookies[i], NULL);
+        if (!name_reply) continue;
         
-        free(version_reply);
-        return 1;
+        int name_len = xcb_get_atom_name_name_length(name_reply);
+        if (name_len > 0 && it.data->width > 0 && it.data->height > 0) {
+            monitor_add(list, count, xcb_get_atom_name_name(name_reply), name_len,
+                it.data->x, it.data->y, it.data->width, it.data->height, it.data->primary);
+            count++;
+        }
+        free(name_reply);
     }
-    free(version_reply);
     
-    // Get screen resources
+    free(mon_reply);
+    return count;
+}
+
+/* RandR 1.2-1.4: one GetOutputInfo per output and one GetCrtcInfo per
+   active CRTC. All requests of a stage are sent before the first reply
+   is read, so discovery costs three round-trips whatever the number of
+   outputs. */
+static int
+get_monitors_randr12(xcb_connection_t *connection, xcb_screen_t *screen, MonitorInfo **listp)
+{
+    int count = 0;
+    
+    // Get screen resources and the primary output together
     xcb_randr_get_screen_resources_current_cookie_t res_cookie = 
         xcb_randr_get_screen_resources_current(connection, screen->root);
-    xcb_randr_get_screen_resources_current_reply_t *res_reply = 
-        xcb_randr_get_screen_resources_current_reply(connection, res_cookie, NULL);
-    
-    if (!res_reply) {
-        printf("Failed to get screen resources, using whole screen\n");
-        
-        // Create a fallback monitor entry
-        monitors[0].x = 0;
-        monitors[0].y = 0;
-        monitors[0].width = screen->width_in_pixels;
-        monitors[0].height = screen->height_in_pixels;
-        monitors[0].primary = 1;
-        monitors[0].enabled = 1;
-        strncpy(monitors[0].name, "default", sizeof(monitors[0].name) - 1);
-        
-        return 1;  // We have one monitor
-    }
-    
-    // Get the primary output
     xcb_randr_get_output_primary_cookie_t primary_cookie = 
         xcb_randr_get_output_primary(connection, screen->root);
+    
+    xcb_randr_get_screen_resources_current_reply_t *res_reply = 
+        xcb_randr_get_screen_resources_current_reply(connection, res_cookie, NULL);
     xcb_randr_get_output_primary_reply_t *primary_reply = 
         xcb_randr_get_output_primary_reply(connection, primary_cookie, NULL);
     
     xcb_randr_output_t primary_output = primary_reply ? primary_reply->output : 0;
     free(primary_reply);
     
+    if (!res_reply) {
+        printf("Failed to get screen resources\n");
+        return 0;
+    }
+    
     // Get outputs
     xcb_randr_output_t *outputs = xcb_randr_get_screen_resources_current_outputs(res_reply);
     int outputs_len = xcb_randr_get_screen_resources_current_outputs_length(res_reply);
+    int n = outputs_len > 0 ? outputs_len : 1;
     
-    for (int i = 0; i < outputs_len && count < MAX_MONITORS; i++) {
-        xcb_randr_get_output_info_cookie_t output_cookie = 
-            xcb_randr_get_output_info(connection, outputs[i], XCB_CURRENT_TIME);
-        xcb_randr_get_output_info_reply_t *output_reply = 
-            xcb_randr_get_output_info_reply(connection, output_cookie, NULL);
+    xcb_randr_get_output_info_cookie_t output_cookies[n];
+    xcb_randr_get_output_info_reply_t *output_replies[n];
+    xcb_randr_get_crtc_info_cookie_t crtc_cookies[n];
+    MonitorInfo *list = *listp = calloc(n, sizeof(MonitorInfo));
+    
+    for (int i = 0; i < outputs_len; i++) {
+        output_cookies[i] = xcb_randr_get_output_info(connection, outputs[i], XCB_CURRENT_TIME);
+    }
+    
+    for (int i = 0; i < outputs_len; i++) {
+        output_replies[i] = xcb_randr_get_output_info_reply(connection, output_cookies[i], NULL);
         
-        if (!output_reply || output_reply->connection != XCB_RANDR_CONNECTION_CONNECTED) {
-            free(output_reply);
-            continue;
+        if (output_replies[i] &&
+            (output_replies[i]->connection != XCB_RANDR_CONNECTION_CONNECTED || output_replies[i]->crtc == XCB_NONE)) {
+            free(output_replies[i]);
+            output_replies[i] = NULL;
         }
+        if (output_replies[i]) {
+            crtc_cookies[i] = xcb_randr_get_crtc_info(connection, output_replies[i]->crtc, XCB_CURRENT_TIME);
+        }
+    }
+    
+    for (int i = 0; i < outputs_len; i++) {
+        if (!output_replies[i]) continue;
         
-        xcb_randr_get_crtc_info_cookie_t crtc_cookie = 
-            xcb_randr_get_crtc_info(connection, output_reply->crtc, XCB_CURRENT_TIME);
-        xcb_randr_get_crtc_info_reply_t *crtc_reply = 
-            xcb_randr_get_crtc_info_reply(connection, crtc_cookie, NULL);
-        
-        if (!crtc_reply) {
-            free(output_reply);
+        if (!list) {
+            xcb_discard_reply(connection, crtc_cookies[i].sequence);
+            free(output_replies[i]);
             continue;
         }
         
+        xcb_randr_get_crtc_info_reply_t *crtc_reply = 
+            xcb_randr_get_crtc_info_reply(connection, crtc_cookies[i], NULL);
+        
         // Get output name
-        const char *name = (const char *)xcb_randr_get_output_info_name(output_reply);
-        int name_len = xcb_randr_get_output_info_name_length(output_reply);
+        const char *name = (const char *)xcb_randr_get_output_info_name(output_replies[i]);
+        int name_len = xcb_randr_get_output_info_name_length(output_replies[i]);
         
-        if (name_len > 0) {
-            // Copy monitor information
-            monitors[count].x = crtc_reply->x;
-            monitors[count].y = crtc_reply->y;
-            monitors[count].width = crtc_reply->width;
-            monitors[count].height = crtc_reply->height;
-            monitors[count].primary = (outputs[i] == primary_output);
-            monitors[count].enabled = 0;  // By default, no monitor is enabled
-            
-            // Copy monitor name (with size limit)
-            size_t max_len = sizeof(monitors[count].name) - 1;
-            size_t copy_len = (name_len < (int)max_len) ? (size_t)name_len : max_len;
-            strncpy(monitors[count].name, name, copy_len);
-            monitors[count].name[copy_len] = '\0';  // Ensure null termination
-            
-            printf("Found monitor: %s (%dx%d at %d,%d) %s\n", 
-                monitors[count].name, 
-                monitors[count].width, 
-                monitors[count].height,
-                monitors[count].x, 
-                monitors[count].y,
-                monitors[count].primary ? "[Primary]" : "");
-                
+        if (crtc_reply && name_len > 0) {
+            monitor_add(list, count, name, name_len, crtc_reply->x, crtc_reply->y,
+                crtc_reply->width, crtc_reply->height, outputs[i] == primary_output);
             count++;
         }
         
         free(crtc_reply);
-        free(output_reply);
+        free(output_replies[i]);
     }
     
     free(res_reply);
+    return count;
+}
+
+/* Get all monitors connected to the system into a newly allocated *list,
+   returns their number */
+int get_all_monitors(xcb_connection_t *connection, xcb_screen_t *screen, MonitorInfo **list) {
+    int count = 0;
+    
+    *list = NULL;
+    
+    // Check if RandR extension is available
+    const xcb_query_extension_reply_t *extension_reply = xcb_get_extension_data(connection, &xcb_randr_id);
+    if (!extension_reply || !extension_reply->present) {
+        printf("RandR extension not available, using whole screen as one monitor\n");
+        return monitors_fallback(list, screen);
+    }
+    
+    // Check RandR version
+    xcb_randr_query_version_cookie_t version_cookie = xcb_randr_query_version(connection, 1, 5);
+    xcb_randr_query_version_reply_t *version_reply = xcb_randr_query_version_reply(connection, version_cookie, NULL);
+    if (!version_reply) {
+        printf("Failed to get RandR version, using whole screen\n");
+        return monitors_fallback(list, screen);
+    }
+    
+    int randr15 = version_reply->major_version > 1 ||
+        (version_reply->major_version == 1 && version_reply->minor_version >= 5);
+    free(version_reply);
+    
+    if (randr15) count = get_monitors_randr15(connection, screen, list);
+    if (count == 0) {
+        free(*list);
+        count = get_monitors_randr12(connection, screen, list);
+    }
     
     // If no monitors were found, use the whole screen as one monitor
     if (count == 0) {
+        free(*list);
         printf("No monitors found, using whole screen\n");
-        
-        monitors[0].x = 0;
-        monitors[0].y = 0;
-        monitors[0].width = screen->width_in_pixels;
-        monitors[0].height = screen->height_in_pixels;
-        monitors[0].primary = 1;
-        monitors[0].enabled = 1;
-        strncpy(monitors[0].name, "default", sizeof(monitors[0].name) - 1);
-        
-        return 1;  // We have one monitor
+        return monitors_fallback(list, screen);
     }
     
     return count;
 }
 
+/* Make room for count monitor slots and their zones. New slots start out
+   zeroed. Returns 0 if memory ran out. */
+int
+monitors_reserve(int count)
+{
+    MonitorInfo *new_monitors;
+    struct str_window_options *new_options;
+    
+    if (count <= monitor_capacity) return 1;
+    
+    new_monitors = realloc(monitors, count * sizeof(MonitorInfo));
+    if (!new_monitors) return 0;
+    monitors = new_monitors;
+    
+    new_options = realloc(window_options, zones_per_monitor * count * sizeof(struct str_window_options));
+    if (!new_options) return 0;
+    window_options = new_options;
+    
+    memset(monitors + monitor_capacity, 0, (count - monitor_capacity) * sizeof(MonitorInfo));
+    memset(window_options + zones_per_monitor * monitor_capacity, 0,
+        zones_per_monitor * (count - monitor_capacity) * sizeof(struct str_window_options));
+    monitor_capacity = count;
+    return 1;
+}
+
 /* Enable a monitor by its name - returns 1 on success, 0 on failure */
 int enable_monitor_by_name(const char *name) {
     if (!name || strlen(name) == 0) {
@@ -262,7 +337,7 @@ int enable_monitor_by_name(const char *name) {
     }
     
     for (int i = 0; i < monitor_count; i++) {
-        if (strcmp(monitors[i].name, name) == 0) {
+        if (monitors[i].connected && strcmp(monitors[i].name, name) == 0) {
             monitors[i].enabled = 1;
             printf("Enabled monitor: %s (%dx%d at %d,%d)\n", 
                 name, monitors[i].width, monitors[i].height,
@@ -279,6 +354,7 @@ int enable_monitor_by_name(const char *name) {
 void print_monitor_list() {
     printf("Available monitors:\n");
     for (int i = 0; i < monitor_count; i++) {
+        if (!monitors[i].connected) continue;
         printf("  %s (%dx%d at %d,%d) %s\n", 
             monitors[i].name, 
             monitors[i].width, 
@@ -289,434 +365,819 @@ void print_monitor_list() {
     }
 }
 
+/* Subscribe to RandR notifications so monitor changes on a display reach
+   the event loop */
 void
-server_create_windows(xcb_connection_t *connection, xcb_screen_t *screen)
+monitors_watch(int display)
 {
-  int i;
+    xcb_connection_t *connection = displays[display].connection;
+    const xcb_query_extension_reply_t *extension_reply = xcb_get_extension_data(connection, &xcb_randr_id);
+    if (!extension_reply || !extension_reply->present) return;
+    
+    xcb_randr_select_input(connection, displays[display].screen->root,
+        XCB_RANDR_NOTIFY_MASK_SCREEN_CHANGE | XCB_RANDR_NOTIFY_MASK_CRTC_CHANGE |
+        XCB_RANDR_NOTIFY_MASK_OUTPUT_CHANGE);
+    displays[display].randr_event_base = extension_reply->first_event;
+}
+
+/* The monitor of a display that has zones when no --monitor names are
+   given: its primary monitor, or its first one. -1 if it has none. */
+static int
+monitors_default(int display)
+{
+    int i;
+    
+    for (i = 0; i < monitor_count; i++) {
+        if (monitors[i].connected && monitors[i].display == display && monitors[i].primary) return i;
+    }
+    for (i = 0; i < monitor_count; i++) {
+        if (monitors[i].connected && monitors[i].display == display) return i;
+    }
+    return -1;
+}
+
+/* Should this monitor have zones: named on the command line, or the
+   default monitor when no names were given */
+static int
+monitor_wanted(int i, int default_monitor)
+{
+    if (requested_count == 0) return i == default_monitor;
+    
+    for (int n = 0; n < requested_count; n++) {
+        if (strcmp(monitors[i].name, requested_monitors[n]) == 0) return 1;
+    }
+    return 0;
+}
+
+/* Give a monitor its zones: layout and windows. Its bindings come with
+   the config reload monitors_update() does afterwards. */
+static void
+monitor_activate(int i)
+{
+    printf("Enabled monitor: %s (%dx%d at %d,%d)\n", 
+        monitors[i].name, monitors[i].width, monitors[i].height,
+        monitors[i].x, monitors[i].y);
+    
+    monitors[i].enabled = 1;
+    init_options(i);
+    
+    for (int z = i * zones_per_monitor; z < (i + 1) * zones_per_monitor; z++) {
+        if (window_options[z].enabled) server_create_zone_window(z);
+    }
+}
+
+/* Take a monitor's zone windows away */
+static void
+monitor_deactivate(int i)
+{
+    xcb_connection_t *connection = displays[monitors[i].display].connection;
+    
+    dwell_cancel(i * zones_per_monitor, zones_per_monitor);
+    
+    for (int z = i * zones_per_monitor; z < (i + 1) * zones_per_monitor; z++) {
+        if (window_options[z].xcb_window) xcb_destroy_window(connection, window_options[z].xcb_window);
+        window_options[z].xcb_window = 0;
+        window_options[z].enabled = 0;
+    }
+    monitors[i].enabled = 0;
+}
+
+/* Lay out a monitor's zones again after its geometry or fittsmonrc
+   changed: move the windows of zones that stay, create and destroy the
+   others. Before the windows are first created there is nothing to move. */
+static void
+monitor_relayout(int i)
+{
+    xcb_connection_t *connection = displays[monitors[i].display].connection;
+    
+    zones_layout(i);
+    unless (windows_created) return;
+    
+    for (int z = i * zones_per_monitor; z < (i + 1) * zones_per_monitor; z++) {
+        if (!window_options[z].enabled) {
+            if (window_options[z].xcb_window) xcb_destroy_window(connection, window_options[z].xcb_window);
+            window_options[z].xcb_window = 0;
+            continue;
+        }
+        if (!window_options[z].xcb_window) {
+            server_create_zone_window(z);
+            continue;
+        }
+        
+        uint32_t values[] = {
+            (uint32_t)window_options[z].x, (uint32_t)window_options[z].y,
+            (uint32_t)window_options[z].w, (uint32_t)window_options[z].h
+        };
+        xcb_configure_window(connection, window_options[z].xcb_window,
+            XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y |
+            XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT, values);
+    }
+}
+
+/* Re-read a display's monitor layout after a RandR change and touch only
+   the zone windows that are affected. Monitors keep their slot for as long
+   as they are connected, so the zones of unchanged monitors keep their
+   windows, bindings and throttle state. New and moved windows are set up
+   before old ones are destroyed and everything goes out in a single flush,
+   so the pointer never finds a gap without zones. */
+void
+monitors_update(int display)
+{
+    xcb_connection_t *connection = displays[display].connection;
+    MonitorInfo *found;
+    int found_count, default_monitor = -1;
+    int activated = 0;
+    int i, j;
+    
+    /* Spans name their monitor */
+    trace_flush();
+    found_count = get_all_monitors(connection, displays[display].screen, &found);
+    display_name_monitors(display, found, found_count);
+    
+    /* Every found monitor may need a slot of its own */
+    if (!monitors_reserve(monitor_count + found_count)) {
+        fprintf(stderr, "Warning: Out of memory, ignoring monitor changes\n");
+        free(found);
+        return;
+    }
+    char seen[monitor_capacity];
+    memset(seen, 0, sizeof(seen));
+    
+    /* A pending burst may belong to a zone that is about to go */
+    dispatch_flush();
+    
+    for (j = 0; j < found_count; j++) {
+        for (i = 0; i < monitor_count; i++) {
+            if (monitors[i].connected && !seen[i] && monitors[i].display == display &&
+                strcmp(monitors[i].name, found[j].name) == 0) break;
+        }
+        
+        if (i == monitor_count) {
+            /* Newly connected: take the first free slot */
+            for (i = 0; i < monitor_count && monitors[i].connected; i++)
+                ;
+            if (i == monitor_count) monitor_count++;
+            
+            monitors[i] = found[j];
+            monitors[i].enabled = 0;
+            seen[i] = 1;
+            printf("Monitor connected: %s\n", monitors[i].name);
+            record_stop("a monitor was connected");
+            continue;
+        }
+        
+        seen[i] = 1;
+        monitors[i].primary = found[j].primary;
+        if (monitors[i].x != found[j].x || monitors[i].y != found[j].y ||
+            monitors[i].width != found[j].width || monitors[i].height != found[j].height) {
+            monitors[i].x = found[j].x;
+            monitors[i].y = found[j].y;
+            monitors[i].width = found[j].width;
+            monitors[i].height = found[j].height;
+            printf("Monitor changed: %s (%dx%d at %d,%d)\n", monitors[i].name,
+                monitors[i].width, monitors[i].height, monitors[i].x, monitors[i].y);
+            if (monitors[i].enabled) monitor_relayout(i);
+        }
+    }
+    
+    free(found);
+    
+    for (i = 0; i < monitor_count; i++) {
+        if (monitors[i].connected && monitors[i].display == display && !seen[i]) {
+            printf("Monitor disconnected: %s\n", monitors[i].name);
+            record_stop("a monitor was disconnected");
+            monitors[i].connected = 0;
+        }
+    }
+    
+    default_monitor = monitors_default(display);
+    
+    for (i = 0; i < monitor_count; i++) {
+        if (monitors[i].display != display) continue;
+        if (monitors[i].connected && !monitors[i].enabled && monitor_wanted(i, default_monitor)) {
+            monitor_activate(i);
+            activated = 1;
+        }
+    }
+    for (i = 0; i < monitor_count; i++) {
+        if (monitors[i].display != display) continue;
+        if (monitors[i].enabled && !(monitors[i].connected && monitor_wanted(i, default_monitor))) {
+            monitor_deactivate(i);
+        }
+    }
+    
+    /* Bindings are resolved per monitor, so a new one needs a fresh table */
+    if (activated) config_reload();
+    
+    zone_map_rebuild();
+    xcb_flush(connection);
+}
+
+/* Create and map the InputOnly window of one zone, on its monitor's
+   display */
+void
+server_create_zone_window(int i)
+{
+  const struct str_display *display = &displays[monitors[i / zones_per_monitor].display];
+  xcb_connection_t *connection = display->connection;
+  xcb_screen_t *screen = display->screen;
   uint32_t values[] = {1, XCB_EVENT_MASK_BUTTON_PRESS | 
     XCB_EVENT_MASK_ENTER_WINDOW | XCB_EVENT_MASK_LEAVE_WINDOW};
+  
+  if (windowless) return;
+  
+  window_options[i].xcb_window = xcb_generate_id (connection);
+      
+  /* InputOnly window to get the focus when no other window can get it */
+  printf("Created a window - x:%d y:%d width:%d height:%d (monitor: %s)\n",
+    window_options[i].x, window_options[i].y, window_options[i].w, window_options[i].h,
+    monitors[i / zones_per_monitor].name);
+    
+  xcb_create_window (connection, 0, window_options[i].xcb_window, screen->root, window_options[i].x,
+        window_options[i].y, window_options[i].w, window_options[i].h, 0,
+        XCB_WINDOW_CLASS_INPUT_ONLY, screen->root_visual,
+        XCB_CW_OVERRIDE_REDIRECT | XCB_CW_EVENT_MASK, values);
+
+  /* Map the window on the screen */
+  xcb_map_window (connection, window_options[i].xcb_window);
+}
+
+void
+server_create_windows(void)
+{
+  int i;
  
-  // Total windows is 8 per enabled monitor
-  int total_windows = 8 * monitor_count;
+  // Total windows is zones_per_monitor per enabled monitor
+  int total_windows = zones_per_monitor * monitor_count;
+  
+  windows_created = 1;
   
   for (i = 0; i < total_windows; i++) {
     unless (window_options[i].enabled) continue;
-    window_options[i].xcb_window = xcb_generate_id (connection);
-        
-    /* InputOnly window to get the focus when no other window can get it */
-    printf("Created a window - x:%d y:%d width:%d height:%d (monitor: %s)\n",
-      window_options[i].x, window_options[i].y, window_options[i].w, window_options[i].h,
-      window_options[i].monitor_name);
-      
-    xcb_create_window (connection, 0, window_options[i].xcb_window, screen->root, window_options[i].x,
-          window_options[i].y, window_options[i].w, window_options[i].h, 0,
-          XCB_WINDOW_CLASS_INPUT_ONLY, screen->root_visual,
-          XCB_CW_OVERRIDE_REDIRECT | XCB_CW_EVENT_MASK, values);
-
-    /* Map the window on the screen */
-    xcb_map_window (connection, window_options[i].xcb_window);
+    server_create_zone_window(i);
+  }
+  
+  for (i = 0; i < display_count; i++) {
+    if (display_owns_connection(i)) xcb_flush(displays[i].connection);
+  }
+  zone_map_rebuild();
+}
 
-    xcb_flush (connection);
+/* Rebuild the XID -> zone lookup from the created windows. Only enabled
+   zones with a window are entered, so disabled zones can never match. */
+void
+zone_map_rebuild (void)
+{
+  int total_windows = zones_per_monitor * monitor_count;
+  unsigned int size = 16;
+  
+  /* Without windows the grid over the zone rectangles is the lookup */
+  if (windowless) {
+    pointer_zones_changed();
+    return;
+  }
+  
+  while (size < 2 * (unsigned int)total_windows) size *= 2;
+  if (size != zone_map_mask + 1) {
+    struct str_zone_map_entry *map = realloc(zone_map, size * sizeof(struct str_zone_map_entry));
+    
+    if (map) {
+      zone_map = map;
+      zone_map_mask = size - 1;
+    } else if (!zone_map || zone_map_mask < (unsigned int)total_windows) {
+      /* Too small to hold every zone: better no zones than a full table */
+      fprintf(stderr, "Warning: Out of memory for the zone lookup table\n");
+      if (zone_map) memset(zone_map, 0, (zone_map_mask + 1) * sizeof(struct str_zone_map_entry));
+      return;
+    }
+  }
+  
+  memset(zone_map, 0, (zone_map_mask + 1) * sizeof(struct str_zone_map_entry));
+  
+  for (int i = 0; i < total_windows; i++) {
+    unless (window_options[i].enabled && window_options[i].xcb_window) continue;
+    
+    unsigned int slot = window_options[i].xcb_window & zone_map_mask;
+    while (zone_map[slot].xid) slot = (slot + 1) & zone_map_mask;
+    zone_map[slot].xid = window_options[i].xcb_window;
+    zone_map[slot].zone = i;
+    zone_map[slot].connection = displays[monitors[i / zones_per_monitor].display].connection;
   }
 }
 
+/* Constant-time XID lookup. XIDs from xcb_generate_id are consecutive,
+   so their low bits index the table with next to no collisions; another
+   X server's windows may share them, so the connection must match too. */
 int
-server_find_window(xcb_window_t win)
+server_find_window(xcb_connection_t *connection, xcb_window_t win)
 {
-  int total_windows = 8 * monitor_count;
-  for (int i = 0; i < total_windows; i++) {
-    if (window_options[i].xcb_window == win) return i;
+  unless (win && zone_map) return -1;
+  
+  for (unsigned int slot = win & zone_map_mask; zone_map[slot].xid; slot = (slot + 1) & zone_map_mask) {
+    if (zone_map[slot].xid == win && zone_map[slot].connection == connection) return zone_map[slot].zone;
   }
   return -1;
 }
 
+/* Resolve one X event from a connection to a zone and hand it to the
+   dispatcher */
 void
-server_event_loop (xcb_connection_t *connection)
+server_handle_event (xcb_connection_t *connection, xcb_generic_event_t *event)
 {
-  char done = 0;
-  int cur_win;
-  xcb_generic_event_t *event;
+  int type = event->response_type & ~0x80;
+  long long received = trace_now(), lookup;
+  int cur_win, mods;
   xcb_button_press_event_t *bp;
   xcb_enter_notify_event_t *enter;
   xcb_leave_notify_event_t *leave;
   
-  while ((event = xcb_wait_for_event (connection))) {
-    switch (event->response_type & ~0x80) {
-      case XCB_BUTTON_PRESS:
-        bp = (xcb_button_press_event_t *)event;
-        cur_win = server_find_window(bp->event);
-        /* printf("this event is coming from window %d \n", cur_win); */
-        if (cur_win < 0) {
-          fprintf(stderr, "Warning: Button press event from unknown window\n");
-          break;
-        }
-        switch (bp->detail) {
-          case LEFT_BUTTON:
-            if (str_defined(get_cmd(cur_win,LeftButton))) {
-              const char *cmd = get_cmd(cur_win,LeftButton);
-              if (is_safe_command(cmd)) {
-                int ret = system(cmd);
-                if (ret != 0) fprintf(stderr, "Command failed with code %d\n", ret);
-              }
-            }
-          break;
-          
-          case MIDDLE_BUTTON:
-            if (str_defined(get_cmd(cur_win,MiddleButton))) {
-              const char *cmd = get_cmd(cur_win,MiddleButton);
-              if (is_safe_command(cmd)) {
-                int ret = system(cmd);
-                if (ret != 0) fprintf(stderr, "Command failed with code %d\n", ret);
-              }
-            }
-            break;
-          case RIGHT_BUTTON:
-            if (str_defined(get_cmd(cur_win,RightButton))) {
-              const char *cmd = get_cmd(cur_win,RightButton);
-              if (is_safe_command(cmd)) {
-                int ret = system(cmd);
-                if (ret != 0) fprintf(stderr, "Command failed with code %d\n", ret);
-              }
-            }
-          break;
-          
-          case WHEEL_UP_BUTTON:
-            if (str_defined(get_cmd(cur_win,WheelUp))) {
-              const char *cmd = get_cmd(cur_win,WheelUp);
-              if (is_safe_command(cmd)) {
-                int ret = system(cmd);
-                if (ret != 0) fprintf(stderr, "Command failed with code %d\n", ret);
-              }
-            }
-            if ( str_defined(get_cmd(cur_win,WheelUpOnce)) && can_execute(cur_win, 0) ) {
-              const char *cmd = get_cmd(cur_win,WheelUpOnce);
-              if (is_safe_command(cmd)) {
-                int ret = system(cmd);
-                if (ret != 0) fprintf(stderr, "Command failed with code %d\n", ret);
-              }
-            }
-          break;
-          
-          case WHEEL_DOWN_BUTTON:
-            if (str_defined(get_cmd(cur_win,WheelDown))) {
-              const char *cmd = get_cmd(cur_win,WheelDown);
-              if (is_safe_command(cmd)) {
-                int ret = system(cmd);
-                if (ret != 0) fprintf(stderr, "Command failed with code %d\n", ret);
-              }
-            }
-            if (str_defined(get_cmd(cur_win,WheelDownOnce)) && can_execute(cur_win, 1) ) {
-              const char *cmd = get_cmd(cur_win,WheelDownOnce);
-              if (is_safe_command(cmd)) {
-                int ret = system(cmd);
-                if (ret != 0) fprintf(stderr, "Command failed with code %d\n", ret);
-              }
-            }
-          break;
-        }
-      break;
-      
-      case XCB_ENTER_NOTIFY:
-        enter = (xcb_enter_notify_event_t *)event;
-        cur_win = server_find_window(enter->event);
-        if (cur_win >= 0 && str_defined(get_cmd(cur_win,Enter))) {
-          const char *cmd = get_cmd(cur_win,Enter);
-          if (is_safe_command(cmd)) {
-            int ret = system(cmd);
-            if (ret != 0) fprintf(stderr, "Command failed with code %d\n", ret);
-          }
-        }
-      break;
-      
-      case XCB_LEAVE_NOTIFY:
-        leave = (xcb_leave_notify_event_t *)event;
-        cur_win = server_find_window(leave->event);
-        if (cur_win >= 0 && str_defined(get_cmd(cur_win,Leave))) {
-          const char *cmd = get_cmd(cur_win,Leave);
-          if (is_safe_command(cmd)) {
-            int ret = system(cmd);
-            if (ret != 0) fprintf(stderr, "Command failed with code %d\n", ret);
-          }
-        }
-      break;
-      
-      default:
-      break;
-    }
+  switch (type) {
+    case XCB_BUTTON_PRESS:
+      bp = (xcb_button_press_event_t *)event;
+      /* Window-less, the press comes from the grab on the root window */
+      lookup = trace_now();
+      cur_win = windowless ? pointer_zone_at(bp->root_x, bp->root_y) : server_find_window(connection, bp->event);
+      trace_span(TRACE_LOOKUP, lookup, cur_win, -1, 0);
+      /* printf("this event is coming from window %d \n", cur_win); */
+      if (cur_win < 0) {
+        /* Window-less, a press can reach the grab after the pointer left
+           the zone, before the ungrab took effect: nothing to report */
+        unless (windowless) fprintf(stderr, "Warning: Button press event from unknown window\n");
+        break;
+      }
+      record_event(type, bp->detail, bp->state, cur_win, bp->time);
+      unless (bp->detail < sizeof(button_events) / sizeof(button_events[0]) && button_events[bp->detail][0] >= 0) break;
+
+      mods = modifiers_reduce(bp->state);
+      dispatch_event(cur_win, button_events[bp->detail][0], mods, bp->time);
+      if (button_events[bp->detail][1] >= 0) dispatch_event(cur_win, button_events[bp->detail][1], mods, bp->time);
+      trace_span(TRACE_RECEIVE, received, cur_win, button_events[bp->detail][0], type);
+    break;
+    
+    case XCB_ENTER_NOTIFY:
+      enter = (xcb_enter_notify_event_t *)event;
+      lookup = trace_now();
+      cur_win = server_find_window(connection, enter->event);
+      trace_span(TRACE_LOOKUP, lookup, cur_win, -1, 0);
+      if (cur_win < 0) break;
+      record_event(type, enter->detail, enter->state, cur_win, enter->time);
+      dispatch_event(cur_win, Enter, 0, enter->time);
+      trace_span(TRACE_RECEIVE, received, cur_win, Enter, type);
+    break;
     
-    free (event);
-    if (done) break;
+    case XCB_LEAVE_NOTIFY:
+      leave = (xcb_leave_notify_event_t *)event;
+      lookup = trace_now();
+      cur_win = server_find_window(connection, leave->event);
+      trace_span(TRACE_LOOKUP, lookup, cur_win, -1, 0);
+      if (cur_win < 0) break;
+      record_event(type, leave->detail, leave->state, cur_win, leave->time);
+      dispatch_event(cur_win, Leave, 0, leave->time);
+      trace_span(TRACE_RECEIVE, received, cur_win, Leave, type);
+    break;
+    
+    case XCB_PROPERTY_NOTIFY:
+      ewmh_property_notify((xcb_property_notify_event_t *)event);
+    break;
+    
+    case XCB_GE_GENERIC:
+      pointer_handle_event(event);
+    break;
+    
+    default:
+      /* Handled once the queued events are drained, however many arrive.
+         Every screen of the connection looks again: cheap, and RandR
+         notifications do not all say which screen they are about. */
+      for (int d = 0; d < display_count; d++) {
+        int base = displays[d].randr_event_base;
+        
+        if (displays[d].connection == connection && base >= 0 &&
+            (type == base + XCB_RANDR_SCREEN_CHANGE_NOTIFY || type == base + XCB_RANDR_NOTIFY)) {
+          displays[d].monitors_changed = 1;
+        }
+      }
+    break;
   }
 }
 
+/* Everything kill -USR1 and fittsmon --stats report */
+void
+server_print_stats (FILE *out)
+{
+  stats_print(out);
+  gesture_print_stats(out);
+  launcher_print_stats(out);
+  helpers_print_stats(out);
+  broadcast_print_stats(out);
+  trace_print_stats(out);
+}
+
+/* The enabled zones, for fittsmon --zones and the benchmark driver */
+void
+server_print_zones (FILE *out)
+{
+  for (int i = 0; i < zones_per_monitor * monitor_count; i++) {
+    unless (window_options[i].enabled) continue;
+    fprintf(out, "%s-%s %d %d %d %d\n", monitors[i / zones_per_monitor].name, zone_name(i),
+            window_options[i].x, window_options[i].y, window_options[i].w, window_options[i].h);
+  }
+  fflush(out);
+}
+
+/* Register fd with the event loop: handle is called with the epoll events
+   whenever it is ready. Returns -1 on failure. */
 int
-can_execute (const int corner, int direction)
+server_watch (int fd, uint32_t events, void (*handle)(int fd, uint32_t events))
 {
-  time_t current_time;
-  time_t* last_exec;
-  long int diff;
+  struct epoll_event ev = { .events = events, .data.fd = fd };
   
-  unless (direction) last_exec = &window_options[corner].last_time_up; 
-    else last_exec = &window_options[corner].last_time_down;
+  if (server_epoll_fd < 0) {
+    server_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (server_epoll_fd < 0) {
+      perror("epoll_create1");
+      return -1;
+    }
+  }
   
-  time(&current_time);
-  diff = (long int) current_time - (long int) *last_exec;
+  if (fd >= watch_capacity) {
+    int capacity = fd + 16;
+    struct str_watch *grown = realloc(watches, capacity * sizeof(struct str_watch));
+    
+    unless (grown) return -1;
+    memset(grown + watch_capacity, 0, (capacity - watch_capacity) * sizeof(struct str_watch));
+    watches = grown;
+    watch_capacity = capacity;
+  }
   
-  if ( !last_exec || ( diff > 2 ) ) {
-    *last_exec = current_time;
-    return 1;
+  if (epoll_ctl(server_epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+    perror("epoll_ctl");
+    return -1;
   }
+  watches[fd].handle = handle;
+  return 0;
+}
+
+/* Change the events a watched fd waits for, 0 for none for now */
+void
+server_watch_modify (int fd, uint32_t events)
+{
+  struct epoll_event ev = { .events = events, .data.fd = fd };
   
-  return 0; 
+  epoll_ctl(server_epoll_fd, EPOLL_CTL_MOD, fd, &ev);
 }
 
-/* Validate command string for dangerous shell metacharacters */
-int
-is_safe_command (const char *cmd)
+/* Stop watching fd, before it is closed. Events for it still in the
+   batch being handled find no handler. */
+void
+server_unwatch (int fd)
 {
-  if (!cmd || strlen(cmd) == 0) return 0;
+  epoll_ctl(server_epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+  if (fd < watch_capacity) watches[fd].handle = NULL;
+}
 
-  /* Create a temporary copy and trim trailing spaces and a single trailing '&' */
-  char buf[256];
-  size_t len = strlen(cmd);
-  if (len >= sizeof(buf)) {
-    fprintf(stderr, "Warning: Command too long (max %zu bytes): %s\n", sizeof(buf) - 1, cmd);
-    return 0; /* overly long - treat as unsafe */
-  }
-  strcpy(buf, cmd);
+/* Handle the X events at hand in batches: with read set, one read from
+   the socket, then whatever xcb has queued, without a syscall per event.
+   Events queued while waiting for a reply never make the socket readable,
+   so the loop also calls this with read unset before it sleeps. */
+static void
+server_drain (xcb_connection_t *connection, int read)
+{
+  xcb_generic_event_t *batch[SERVER_BATCH_SIZE];
+  int n, i;
+  
+  do {
+    n = 0;
+    if (read && (batch[n] = xcb_poll_for_event(connection))) n++;
+    read = 0;
+    while (n < SERVER_BATCH_SIZE && (batch[n] = xcb_poll_for_queued_event(connection))) n++;
+    
+    for (i = 0; i < n; i++) {
+      /* Only the last of a run of raw motion events says where the
+         pointer is going; a click in between keeps its own position */
+      unless (i + 1 < n && pointer_is_motion(batch[i]) && pointer_is_motion(batch[i + 1])) {
+        server_handle_event(connection, batch[i]);
+      }
+      free(batch[i]);
+    }
+  } while (n == SERVER_BATCH_SIZE);
+}
 
-  /* Trim trailing whitespace */
-  while (len > 0 && (buf[len-1] == ' ' || buf[len-1] == '\t')) {
-    buf[--len] = '\0';
+/* One of the X connections is readable */
+static void
+server_read_events (int fd, uint32_t events)
+{
+  for (int d = 0; d < display_count; d++) {
+    if (displays[d].fd == fd) {
+      server_drain(displays[d].connection, 1);
+      return;
+    }
   }
+}
 
-  /* If the last non-space char is '&', remove it for validation (allow backgrounding)
-     but keep it in the stored command; this only strips for the safety check. */
-  if (len > 0 && buf[len-1] == '&') {
-    buf[--len] = '\0';
-    while (len > 0 && (buf[len-1] == ' ' || buf[len-1] == '\t')) {
-      buf[--len] = '\0';
+/* A connection broke, e.g. its X server went away: the zones of its
+   screens are gone. Returns the number of displays still there. */
+static int
+server_lose_display (xcb_connection_t *connection)
+{
+  int left = 0;
+  
+  for (int d = 0; d < display_count; d++) {
+    if (displays[d].connection == connection && !displays[d].lost) {
+      if (displays[d].name) fprintf(stderr, "Lost the connection to display %s\n", displays[d].name);
+      displays[d].lost = 1;
+      if (display_owns_connection(d)) server_unwatch(displays[d].fd);
+      for (int i = 0; i < monitor_count; i++) {
+        if (monitors[i].display == d && monitors[i].connected) {
+          if (monitors[i].enabled) monitor_deactivate(i);
+          monitors[i].connected = 0;
+        }
+      }
     }
+    unless (displays[d].lost) left++;
   }
+  zone_map_rebuild();
+  return left;
+}
 
-  /* Check for dangerous shell metacharacters (excluding '&' because handled above) */
-  const char *dangerous = ";|><`$()\\\"'";
-  size_t safe_len = strcspn(buf, dangerous);
+/* Set by SIGTERM or SIGINT: the event loop ends after this round */
+static int server_quit = 0;
 
-  if (safe_len != strlen(buf)) {
-    fprintf(stderr, "Warning: Potentially dangerous command blocked (contains shell metacharacters): %s\n", cmd);
-    return 0;
+/* SIGCHLD, SIGUSR1, SIGTERM and SIGINT, read from the signalfd */
+static void
+server_read_signals (int fd, uint32_t events)
+{
+  struct signalfd_siginfo info[8];
+  int reap = 0, print = 0;
+  ssize_t len;
+  
+  while ((len = read(fd, info, sizeof(info))) > 0) {
+    for (int i = 0; i < len / (ssize_t)sizeof(info[0]); i++) {
+      if (info[i].ssi_signo == SIGCHLD) reap = 1;
+      if (info[i].ssi_signo == SIGUSR1) print = 1;
+      if (info[i].ssi_signo == SIGTERM || info[i].ssi_signo == SIGINT) server_quit = 1;
+    }
   }
+  
+  if (reap) spawn_reap();
+  /* kill -USR1 dumps the counters and latency histograms */
+  if (print) server_print_stats(stdout);
+}
 
-  return 1;
+/* Block the signals the event loop takes through a signalfd. Done before
+   any thread or child is started, so none of them sees the signals. */
+static int
+server_signals (void)
+{
+  sigset_t mask;
+  
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGCHLD);
+  sigaddset(&mask, SIGUSR1);
+  /* Stopping goes through the cleanup at the end of main */
+  sigaddset(&mask, SIGTERM);
+  sigaddset(&mask, SIGINT);
+  sigprocmask(SIG_BLOCK, &mask, NULL);
+  
+  return signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
 }
 
+/* One epoll set over the X connections, the signalfd, the config watch,
+   the dwell timer and the broadcast sockets, which register themselves.
+   The timeout wakes the loop early when a coalesced burst is due. Runs
+   until no display is left or fittsmon is told to stop. */
 void
-init_options (int monitor_index)
+server_event_loop (int signal_fd)
 {
-  if (monitor_index < 0 || monitor_index >= monitor_count) return;
+  struct epoll_event ready[SERVER_EPOLL_EVENTS];
+  int config_fd = config_watch();
+  int dwell_fd = dwell_init();
+  int trace_fd = trace_watch_fd();
+  int left = display_count;
+  int n, d;
   
-  // Get monitor dimensions and position
-  int x = monitors[monitor_index].x;
-  int y = monitors[monitor_index].y;
-  int screen_width = monitors[monitor_index].width;
-  int screen_height = monitors[monitor_index].height;
+  for (d = 0; d < display_count; d++) {
+    unless (display_owns_connection(d)) continue;
+    if (server_watch(displays[d].fd, EPOLLIN, server_read_events) < 0) return;
+  }
+  if (signal_fd >= 0) server_watch(signal_fd, EPOLLIN, server_read_signals);
   
-  // Calculate the base index for this monitor's windows (8 windows per monitor)
-  int base_idx = monitor_index * 8;
+  /* fittsmonrc is re-read when it changes on disk */
+  if (config_fd >= 0) server_watch(config_fd, EPOLLIN, config_watch_handle);
   
-  // Initialize all 8 windows for this monitor
-  for (int i = 0; i < 8; i++) {
-    int idx = base_idx + i;
-    window_options[idx].enabled = monitors[monitor_index].enabled;
-    window_options[idx].last_time_down = (time_t) 0;
-    window_options[idx].last_time_up = (time_t) 0;
-    strncpy(window_options[idx].monitor_name, monitors[monitor_index].name, sizeof(window_options[idx].monitor_name) - 1);
-  }
-  
-  // Set window sizes relative to screen
-  window_options[base_idx + TopLeft].w = 5;
-  window_options[base_idx + TopLeft].h = 5;
-  window_options[base_idx + TopCenter].w = screen_width*0.6;
-  window_options[base_idx + TopCenter].h = 2;
-  window_options[base_idx + TopRight].w = 6;
-  window_options[base_idx + TopRight].h = 5;
-  window_options[base_idx + Right].w = 3;
-  window_options[base_idx + Right].h = screen_height*0.6;
-  window_options[base_idx + BottomRight].w = 6;
-  window_options[base_idx + BottomRight].h = 6;
-  window_options[base_idx + BottomCenter].w = screen_width*0.6;
-  window_options[base_idx + BottomCenter].h = 2;
-  window_options[base_idx + BottomLeft].w = 5;
-  window_options[base_idx + BottomLeft].h = 5;
-  window_options[base_idx + Left].w = 2;
-  window_options[base_idx + Left].h = screen_height*0.6;
-  
-  // Position the windows relative to the monitor offset
-  window_options[base_idx + TopLeft].x = x;
-  window_options[base_idx + TopLeft].y = y;
-  window_options[base_idx + TopCenter].x = x + (screen_width - window_options[base_idx + TopCenter].w)/2;
-  window_options[base_idx + TopCenter].y = y;
-  window_options[base_idx + TopRight].x = x + screen_width - 5;
-  window_options[base_idx + TopRight].y = y;
-  window_options[base_idx + Right].x = x + screen_width - 2;
-  window_options[base_idx + Right].y = y + (screen_height - window_options[base_idx + Right].h)/2;
-  window_options[base_idx + BottomRight].x = x + screen_width - 5;
-  window_options[base_idx + BottomRight].y = y + screen_height - 5;
-  window_options[base_idx + BottomCenter].x = x + (screen_width - window_options[base_idx + BottomCenter].w)/2;
-  window_options[base_idx + BottomCenter].y = y + screen_height - 2;
-  window_options[base_idx + BottomLeft].x = x;
-  window_options[base_idx + BottomLeft].y = y + screen_height - 5;
-  window_options[base_idx + Left].x = x;
-  window_options[base_idx + Left].y = y + (screen_height - window_options[base_idx + Left].h)/2;
-}
-
-void 
-config_read_file (const char *file_path)
-{
-  GKeyFile* config_file;
-  gchar* sections[] = {"TopLeft", "TopCenter", "TopRight", "Right", "BottomRight", "BottomCenter", "BottomLeft", "Left"};
-  gchar* events[] = {"LeftButton", "MiddleButton", "RightButton", "WheelUp", "WheelDown", "WheelUpOnce", "WheelDownOnce", "Enter", "Leave"};
-  gchar* current_value;
-  int i, j, m;
-  gchar* group_name;
-
-  config_file = g_key_file_new();
-  
-  unless (g_key_file_load_from_file(config_file, file_path, G_KEY_FILE_NONE, NULL)) return;
-  
-  // Process "Default" section first - this will apply to all enabled monitors
-  for (i = 0; i < 8; i++) {
-    group_name = g_strdup(sections[i]);
-    
-    if (g_key_file_has_group(config_file, group_name)) {
-      // Apply default settings to all enabled monitors
-      for (m = 0; m < monitor_count; m++) {
-        if (!monitors[m].enabled) continue;
-        
-        int base_idx = m * 8;
-        window_options[base_idx + i].enabled = 1;
-        
-        for (j = 0; j < 9; j++) {
-          if ((current_value = g_key_file_get_value(config_file, group_name, events[j], NULL))) {
-            gchar *cmd_to_use = current_value;
-            gchar *allocated_cmd = NULL;
-            
-            unless (g_str_has_suffix(current_value, "&")) {
-              allocated_cmd = g_strdup_printf("%s &", current_value);
-              cmd_to_use = allocated_cmd;
-            }
-            
-            strncpy(window_options[base_idx + i].commands[j], cmd_to_use, 199);
-            window_options[base_idx + i].commands[j][199] = '\0';
-            printf("Default %s %s : %s (monitor: %s)\n", 
-                  sections[i], events[j], cmd_to_use, monitors[m].name);
-            
-            g_free(allocated_cmd);
-            g_free(current_value);
-          }
-        }
+  /* Dwell=, bindings waiting for the pointer to stay in their zone */
+  if (dwell_fd >= 0) server_watch(dwell_fd, EPOLLIN, dwell_handle);
+  
+  /* --trace, the launcher's spans waiting to be written */
+  if (trace_fd >= 0) server_watch(trace_fd, EPOLLIN, trace_handle);
+  
+  for (;;) {
+    for (d = 0; d < display_count; d++) {
+      unless (display_owns_connection(d) && !displays[d].lost) continue;
+      
+      server_drain(displays[d].connection, 0);
+      if (xcb_connection_has_error(displays[d].connection)) left = server_lose_display(displays[d].connection);
+    }
+    unless (left) break;
+    if (windowless) pointer_poll();
+    ewmh_poll();
+    
+    for (d = 0; d < display_count; d++) {
+      if (displays[d].monitors_changed && !displays[d].lost) {
+        displays[d].monitors_changed = 0;
+        monitors_update(d);
       }
     }
     
-    g_free(group_name);
-  }
-  
-  // Now process monitor-specific sections (overrides defaults)
-  for (m = 0; m < monitor_count; m++) {
-    if (!monitors[m].enabled) continue;
+    for (d = 0; d < display_count; d++) {
+      if (display_owns_connection(d) && !displays[d].lost) xcb_flush(displays[d].connection);
+    }
+    record_flush();
+    trace_flush();
+    n = epoll_wait(server_epoll_fd, ready, SERVER_EPOLL_EVENTS, dispatch_timeout());
+    if (n < 0 && errno != EINTR) {
+      perror("epoll_wait");
+      break;
+    }
+    dispatch_expire();
     
-    for (i = 0; i < 8; i++) {
-      // Create group name in format "MonitorName-TopLeft", etc.
-      group_name = g_strdup_printf("%s-%s", monitors[m].name, sections[i]);
+    for (int i = 0; i < n; i++) {
+      int fd = ready[i].data.fd;
       
-      if (g_key_file_has_group(config_file, group_name)) {
-        int base_idx = m * 8;
-        window_options[base_idx + i].enabled = 1;
-        
-        for (j = 0; j < 9; j++) {
-          if ((current_value = g_key_file_get_value(config_file, group_name, events[j], NULL))) {
-            gchar *cmd_to_use = current_value;
-            gchar *allocated_cmd = NULL;
-            
-            unless (g_str_has_suffix(current_value, "&")) {
-              allocated_cmd = g_strdup_printf("%s &", current_value);
-              cmd_to_use = allocated_cmd;
-            }
-            
-            strncpy(window_options[base_idx + i].commands[j], cmd_to_use, 199);
-            window_options[base_idx + i].commands[j][199] = '\0';
-            printf("%s %s : %s (monitor: %s)\n", 
-                  sections[i], events[j], cmd_to_use, monitors[m].name);
-            
-            g_free(allocated_cmd);
-            g_free(current_value);
-          }
-        }
-      }
-      
-      g_free(group_name);
+      if (fd < watch_capacity && watches[fd].handle) watches[fd].handle(fd, ready[i].events);
     }
+    if (server_quit) break;
   }
-  
-  g_key_file_free(config_file);
+  record_flush();
+  trace_flush();
 }
 
-void 
-fill_file(const char *file_path)
+/* --replay: a recording stands in for the X servers. Its monitors get
+   their zones and fittsmonrc its bindings as usual; each zone gets a
+   stand-in window id for the lookup, and commands are not started. */
+static int
+replay_main (const char *path, int fast)
 {
-  FILE *fp;
-  int  i;
-   
-  char* lines[] = {
-    "#fittsmonrc example\n",
-    "#volume control in the top right corner:\n\n",
-    "[TopRight]\n",
-    "WheelUp=amixer -q sset Master 2+\n",
-    "WheelDown=amixer -q sset Master 2-\n",
-    "RightButton=amixer -q sset Master toggle\n",
-    "LeftButton=xterm -C alsamixer\n\n\n",
-    "#Multi-monitor configuration example:\n",
-    "#[DP-0-TopLeft]\n",
-    "#LeftButton=notify-send \"Clicked on DP-0 Top Left\"\n\n",
-    "#[HDMI-0-BottomRight]\n",
-    "#RightButton=notify-send \"Clicked on HDMI-0 Bottom Right\"\n\n",
-    "#Available positions: Left, TopLeft, TopCenter, TopRight, Right, BottomRight, BottomCenter, BottomLeft\n",
-    "#Available events: LeftButton, RightButton, MiddleButton, WheelUp, WheelDown, WheelUpOnce, WheelDownOnce, Enter, Leave\n",
-    "#Monitor-specific config format: [MonitorName-Position]\n"
-  };
+  int i;
+  
+  if (replay_open(path) < 0) return 1;
+  
+  for (i = 0; i < monitor_count; i++) {
+    if (monitors[i].enabled) init_options(i);
+  }
+  
+  spawn_dry_run = 1;
+  spawn_init();
+  if (config_read() < 0) return 1;
+  
+  for (i = 0; i < zones_per_monitor * monitor_count; i++) {
+    if (window_options[i].enabled) window_options[i].xcb_window = i + 1;
+  }
+  zone_map_rebuild();
+  
+  if (replay_run(fast) < 0) return 1;
+  trace_flush();
+  server_print_stats(stdout);
+  return 0;
+}
 
-  fp = fopen(file_path, "wb");
-  if (fp == NULL) return;
+void
+init_options (int monitor_index)
+{
+  if (monitor_index < 0 || monitor_index >= monitor_count) return;
+  
+  // Calculate the base index for this monitor's windows
+  int base_idx = monitor_index * zones_per_monitor;
+  
+  // Initialize all windows for this monitor
+  for (int i = 0; i < zones_per_monitor; i++) {
+    int idx = base_idx + i;
+    memset(window_options[idx].buckets, 0, sizeof(window_options[idx].buckets));
+    memset(window_options[idx].counts, 0, sizeof(window_options[idx].counts));
+  }
+  
+  zones_layout(monitor_index);
+}
 
-  for (i = 0; i < 15; i++) fputs(lines[i], fp);
+/* Where the 8 positions sit on their monitor: 0 at the left or top
+   edge, 1 centred, 2 at the right or bottom edge */
+static const unsigned char position_anchors[8][2] = {
+  {0, 0}, {1, 0}, {2, 0}, {2, 1}, {2, 2}, {1, 2}, {0, 2}, {0, 1}
+};
 
-  fclose (fp);
+/* A length in pixels, percentages taken of extent */
+static int
+length_pixels (const struct str_length *length, int extent)
+{
+  return length->percent ? (int)(length->value * extent / 100) : (int)length->value;
 }
 
-void 
-config_read ()
+/* Compute the geometry of a monitor's zones from its current position
+   and size and from fittsmonrc: corners are CornerSize square, edges
+   EdgeThickness by EdgeLength, centred, unless a zone's own section
+   says otherwise. Named zones exist where a section gives them a Width
+   and Height. Zones are kept inside their monitor. Leaves commands and
+   throttle state alone. */
+void
+zones_layout (int monitor_index)
 {
-  char *path;
+  const struct str_layout *layout = bindings ? &bindings->layout : NULL;
+  const MonitorInfo *monitor = &monitors[monitor_index];
+  int extents[4] = { monitor->width, monitor->height, monitor->width, monitor->height };
+  struct str_length sizes[4] = { {5, 0}, {2, 0}, {60, 1}, {0, 0} };
   
-  /* check fittsmonrc in user directory */
-  path = g_build_filename (g_get_user_config_dir(), "fittsmon", "fittsmonrc", NULL);
-  if (g_file_test (path, G_FILE_TEST_EXISTS)) {
-    config_read_file(path);
-    g_free(path);
-    return;
+  // Calculate the base index for this monitor's windows
+  int base_idx = monitor_index * zones_per_monitor;
+  
+  if (layout) layout_lookup(layout, -1, monitor->name, sizes);
+  
+  for (int i = 0; i < zones_per_monitor; i++) {
+    struct str_window_options *o = &window_options[base_idx + i];
+    struct str_length geometry[4];
+    unsigned int set = 0;
+    int v[4];
+    
+    /* X, Y, Width, Height; X and Y are only used when given */
+    memset(geometry, 0, sizeof(geometry));
+    if (i < 8) {
+      const unsigned char *anchor = position_anchors[i];
+      
+      geometry[2] = anchor[0] == 1 ? sizes[2] : anchor[1] == 1 ? sizes[1] : sizes[0];
+      geometry[3] = anchor[1] == 1 ? sizes[2] : anchor[0] == 1 ? sizes[1] : sizes[0];
+      set = 0xc;
+    }
+    if (layout) set |= layout_lookup(layout, i, monitor->name, geometry);
+    
+    for (int k = 0; k < 4; k++) v[k] = length_pixels(&geometry[k], extents[k]);
+    if (v[2] > monitor->width) v[2] = monitor->width;
+    if (v[3] > monitor->height) v[3] = monitor->height;
+    
+    if (i < 8) {
+      if (!(set & 1)) v[0] = (monitor->width - v[2]) * position_anchors[i][0] / 2;
+      if (!(set & 2)) v[1] = (monitor->height - v[3]) * position_anchors[i][1] / 2;
+    }
+    if (v[0] > monitor->width - v[2]) v[0] = monitor->width - v[2];
+    if (v[1] > monitor->height - v[3]) v[1] = monitor->height - v[3];
+    
+    o->x = monitor->x + v[0];
+    o->y = monitor->y + v[1];
+    o->w = v[2];
+    o->h = v[3];
+    o->enabled = monitor->enabled && (set & 0xc) == 0xc && o->w > 0 && o->h > 0;
   }
+}
 
-  char *dir = g_build_filename (g_get_user_config_dir(), "fittsmon", NULL);
-  if (!g_file_test (dir, G_FILE_TEST_IS_DIR)) g_mkdir(dir, 0777);
-  g_free(dir);
+/* Make room for count zones per monitor. Zone indexes change with the
+   count, so every zone starts afresh: windows, throttle state and
+   counters. The caller lays them out again. Returns -1, changing
+   nothing, if memory ran out. */
+int
+zones_resize (int count)
+{
+  struct str_window_options *options;
+  
+  if (count == zones_per_monitor) return 0;
+  
+  options = calloc((size_t)count * monitor_capacity, sizeof(struct str_window_options));
+  unless (options) {
+    fprintf(stderr, "Warning: Out of memory for %d zones per monitor\n", count);
+    return -1;
+  }
+  
+  for (int i = 0; i < zones_per_monitor * monitor_count; i++) {
+    if (window_options[i].xcb_window) {
+      xcb_destroy_window(displays[monitors[i / zones_per_monitor].display].connection, window_options[i].xcb_window);
+    }
+  }
+  if (windowless) pointer_forget();
+  dwell_cancel(0, zones_per_monitor * monitor_count);
+  
+  /* Records already written are numbered by the old count */
+  record_stop("the zones per monitor changed");
+  
+  free(window_options);
+  window_options = options;
+  zones_per_monitor = count;
+  return 0;
+}
 
-  path = g_build_filename (g_get_user_config_dir(), "fittsmon", "fittsmonrc", NULL);
-  fill_file(path);
-  printf("Created a sample fittsmonrc for you in %s \n", path);
+/* Bring the zones of every enabled monitor in line with the installed
+   fittsmonrc */
+void
+zones_configure (void)
+{
+  for (int i = 0; i < monitor_count; i++) {
+    if (monitors[i].enabled) monitor_relayout(i);
+  }
+  zone_map_rebuild();
+}
 
-  config_read_file (path);
-  g_free(path);
+/* Name of a zone as fittsmonrc sections, helpers and subscribers know it */
+const char *
+zone_name (int zone)
+{
+  int i = zone % zones_per_monitor;
+  
+  return i < 8 ? section_names[i] : bindings->layout.names[i - 8];
 }
 
 void print_usage() {
@@ -730,6 +1191,14 @@ void print_usage() {
     printf("OPTIONS:\n");
     printf("  -h, --help                Show this help message\n");
     printf("  -l, --list                List available monitors\n");
+    printf("  --stats                   Print counters and latencies of the running fittsmon\n");
+    printf("  --zones                   Print the zone rectangles of the running fittsmon\n");
+    printf("  --windowless              Track the pointer with XInput2 instead of zone windows\n");
+    printf("  --display name            Serve this X display or screen; repeat for more\n");
+    printf("  --record file             Write the zone events to a file for --replay\n");
+    printf("  --replay file             Feed a recording through the event path without\n");
+    printf("                            X or starting commands; --fast: not at its pace\n");
+    printf("  --trace file              Write Chrome trace-event JSON spans of each event\n");
     printf("  --monitor name ...        Enable specific monitors by name\n");
     printf("\n");
     printf("EXAMPLES:\n");
@@ -737,6 +1206,7 @@ void print_usage() {
     printf("  fittsmon --monitor DP-0   # Use single monitor\n");
     printf("  fittsmon --monitor DP-0 HDMI-0 eDP-1  # Use multiple monitors\n");
     printf("  fittsmon --list           # List available monitors\n");
+    printf("  fittsmon --display :0.0 --display :0.1  # Both screens of a Zaphod setup\n");
     printf("\n");
     printf("CONFIGURATION:\n");
     printf("  Config file: ~/.config/fittsmon/fittsmonrc\n");
@@ -749,7 +1219,9 @@ void print_usage() {
     printf("AVAILABLE EVENTS:\n");
     printf("  LeftButton, RightButton, MiddleButton,\n");
     printf("  WheelUp, WheelDown, WheelUpOnce, WheelDownOnce,\n");
+    printf("  WheelLeft, WheelRight, Button8, Button9,\n");
     printf("  Enter, Leave\n");
+    printf("  Buttons take modifiers: Shift+, Ctrl+, Alt+, Super+ (Shift+WheelUp=...)\n");
     printf("\n");
     printf("CONFIG SYNTAX:\n");
     printf("  [Position]              # Default for all enabled monitors\n");
@@ -758,6 +1230,37 @@ void print_usage() {
     printf("\n");
     printf("  [MonitorName-Position]  # Monitor-specific override\n");
     printf("  LeftButton=command\n");
+    printf("  [:1/HDMI-0-Position]    # Monitors of the second and later displays\n");
+    printf("\n");
+    printf("ZONE GEOMETRY (pixels, or percent of the monitor):\n");
+    printf("  [Settings] CornerSize=5, EdgeThickness=2, EdgeLength=60%%\n");
+    printf("  [Settings] Zones=Name;...  # Extra zones, bound like positions\n");
+    printf("  Width=, Height=, X=, Y=    # In a zone section; named zones need a size\n");
+    printf("\n");
+    printf("BINDING OPTIONS:\n");
+    printf("  Event.Shell=true        # Run the command through /bin/sh -c\n");
+    printf("  Event.Coalesce=ms       # Merge repeated presses into one launch,\n");
+    printf("                          # %%n in the command is the press count\n");
+    printf("  Event.Rate=n            # At most n launches per second (token bucket)\n");
+    printf("  Event.Burst=n           # Launches allowed back to back (default 1)\n");
+    printf("  Event.Dwell=ms          # Launch only if the pointer stays in the zone\n");
+    printf("                          # that long, e.g. Enter.Dwell=300\n");
+    printf("  Event.Policy=single     # While it still runs: parallel, single,\n");
+    printf("                          # replace or queue:N\n");
+    printf("\n");
+    printf("GESTURES:\n");
+    printf("  [Settings] Gestures=Name;...\n");
+    printf("  [Name]                  # One section per gesture\n");
+    printf("  Sequence=TopLeft:Enter TopRight:Enter\n");
+    printf("  Within=400              # First step to last, in ms\n");
+    printf("  Command=command\n");
+    printf("\n");
+    printf("HELPERS:\n");
+    printf("  Helper=command          # In a position or [Settings] section: start once,\n");
+    printf("                          # write 'zone event monitor time count' per event\n");
+    printf("\n");
+    printf("BUILT-IN ACTIONS (no process is started):\n");
+    printf("  @desktop-next, @desktop-prev, @show-desktop, @close-window, @minimize-window\n");
     printf("\n");
     printf("EXAMPLE CONFIG:\n");
     printf("  [TopRight]\n");
@@ -769,9 +1272,10 @@ void print_usage() {
     printf("  LeftButton=notify-send 'DP-0 Bottom Right Clicked'\n");
     printf("\n");
     printf("NOTES:\n");
-    printf("  - Commands are executed in the background with '&' appended\n");
-    printf("  - Commands containing shell metacharacters are blocked for security\n");
-    printf("  - WheelUpOnce/WheelDownOnce execute only once every 2+ seconds\n");
+    printf("  - Commands are started directly in the background, without a shell\n");
+    printf("  - Commands containing shell metacharacters are blocked for security;\n");
+    printf("    set Event.Shell=true to run a binding through /bin/sh instead\n");
+    printf("  - WheelUpOnce/WheelDownOnce default to Rate=0.5, once every 2 seconds\n");
     printf("\n");
 }
 
@@ -779,23 +1283,82 @@ void print_usage() {
 int
 main(int argc, char* argv[])
 {
-  xcb_connection_t *connection;
-  xcb_screen_t *screen;
-  int i;
+  const char *display_names[argc];
+  int display_name_count = 0;
+  const char *record_path = NULL, *replay_path = NULL, *trace_path = NULL;
+  int fast = 0;
+  int signal_fd;
+  int i, d;
   
-  /* open connection to X server. */
-  connection = xcb_connect(NULL, NULL);
-  
-  if (xcb_connection_has_error(connection)) {
-    fprintf(stderr, "Failed to connect to X server\n");
-    return 1;
+  /* --windowless, --display, --record, --replay, --fast and --trace may
+     come anywhere, the other arguments are positional */
+  for (i = 1; i < argc; i++) {
+    int taken = 0;
+    
+    if (strcmp(argv[i], "--windowless") == 0) {
+      windowless = 1;
+      taken = 1;
+    } else if (strcmp(argv[i], "--display") == 0) {
+      if (i + 1 == argc) {
+        fprintf(stderr, "Error: --display requires a display name\n");
+        return 1;
+      }
+      display_names[display_name_count++] = argv[i + 1];
+      taken = 2;
+    } else if (strcmp(argv[i], "--record") == 0 || strcmp(argv[i], "--replay") == 0 ||
+               strcmp(argv[i], "--trace") == 0) {
+      if (i + 1 == argc) {
+        fprintf(stderr, "Error: %s requires a file name\n", argv[i]);
+        return 1;
+      }
+      if (strcmp(argv[i], "--record") == 0) record_path = argv[i + 1];
+      else if (strcmp(argv[i], "--replay") == 0) replay_path = argv[i + 1];
+      else trace_path = argv[i + 1];
+      taken = 2;
+    } else if (strcmp(argv[i], "--fast") == 0) {
+      fast = 1;
+      taken = 1;
+    }
+    if (taken) {
+      memmove(&argv[i], &argv[i + taken], (argc - i - taken + 1) * sizeof(char *));
+      argc -= taken;
+      i--;
+    }
   }
   
-  /* get screen */
-  screen = xcb_setup_roots_iterator(xcb_get_setup(connection)).data;
+  /* Ask the running instance, no X connection needed */
+  if (argc > 1 && strcmp(argv[1], "--stats") == 0) return broadcast_query("stats");
+  if (argc > 1 && strcmp(argv[1], "--zones") == 0) return broadcast_query("zones");
+  
+  /* Spans of the event pipeline, from the first config read on */
+  if (trace_path && trace_start(trace_path) < 0) return 1;
+  
+  /* Offline, from a recording */
+  if (replay_path) return replay_main(replay_path, fast);
+  
+  /* open connections to the X servers: $DISPLAY unless --display says otherwise */
+  if (display_name_count == 0) display_names[display_name_count++] = NULL;
+  for (i = 0; i < display_name_count; i++) {
+    if (display_add(display_names[i]) < 0) {
+      displays_disconnect();
+      return 1;
+    }
+  }
   
-  /* Get all monitors */
-  monitor_count = get_all_monitors(connection, screen);
+  /* Get all monitors of every display */
+  for (d = 0; d < display_count; d++) {
+    MonitorInfo *found;
+    int found_count = get_all_monitors(displays[d].connection, displays[d].screen, &found);
+    
+    display_name_monitors(d, found, found_count);
+    if (!found || !monitors_reserve(monitor_count + found_count)) {
+      fprintf(stderr, "Out of memory\n");
+      return 1;
+    }
+    memcpy(monitors + monitor_count, found, found_count * sizeof(MonitorInfo));
+    monitor_count += found_count;
+    free(found);
+  }
   
   /* Process command line arguments */
   int any_monitor_enabled = 0;
@@ -805,13 +1368,13 @@ main(int argc, char* argv[])
     if (strcmp(argv[1], "--help") == 0 || strcmp(argv[1], "-h") == 0) {
       print_usage();
       print_monitor_list();
-      xcb_disconnect(connection);
+      displays_disconnect();
       return 0;
     }
     
     if (strcmp(argv[1], "--list") == 0 || strcmp(argv[1], "-l") == 0) {
       print_monitor_list();
-      xcb_disconnect(connection);
+      displays_disconnect();
       return 0;
     }
     
@@ -820,10 +1383,12 @@ main(int argc, char* argv[])
       if (argc < 3) {
         fprintf(stderr, "Error: --monitor requires at least one monitor name\n");
         print_usage();
-        xcb_disconnect(connection);
+        displays_disconnect();
         return 1;
       }
       /* Enable specified monitors after --monitor flag */
+      requested_monitors = argv + 2;
+      requested_count = argc - 2;
       for (i = 2; i < argc; i++) {
         enable_monitor_by_name(argv[i]);
         any_monitor_enabled = 1;
@@ -831,11 +1396,13 @@ main(int argc, char* argv[])
       
       if (!any_monitor_enabled) {
         fprintf(stderr, "Error: No valid monitors specified after --monitor\n");
-        xcb_disconnect(connection);
+        displays_disconnect();
         return 1;
       }
     } else {
       /* Legacy behavior: treat all args as monitor names (for backward compatibility) */
+      requested_monitors = argv + 1;
+      requested_count = argc - 1;
       for (i = 1; i < argc; i++) {
         enable_monitor_by_name(argv[i]);
         any_monitor_enabled = 1;
@@ -843,25 +1410,17 @@ main(int argc, char* argv[])
       
       if (!any_monitor_enabled) {
         fprintf(stderr, "Error: No valid monitors specified\n");
-        xcb_disconnect(connection);
+        displays_disconnect();
         return 1;
       }
     }
   } else {
-    /* No arguments, enable primary monitor or first monitor (default) */
-    int primary_found = 0;
-    for (i = 0; i < monitor_count; i++) {
-      if (monitors[i].primary) {
-        monitors[i].enabled = 1;
-        primary_found = 1;
-        printf("No monitor specified, using primary monitor: %s\n", monitors[i].name);
-        break;
-      }
-    }
-    
-    if (!primary_found && monitor_count > 0) {
-      monitors[0].enabled = 1;
-      printf("No primary monitor found, using first monitor: %s\n", monitors[0].name);
+    /* No arguments, enable the primary monitor or first monitor (default) of every display */
+    for (d = 0; d < display_count; d++) {
+      if ((i = monitors_default(d)) < 0) continue;
+      monitors[i].enabled = 1;
+      printf("No monitor specified, using %s monitor: %s\n", monitors[i].primary ? "primary" : "first",
+             monitors[i].name);
     }
   }
   
@@ -872,17 +1431,63 @@ main(int argc, char* argv[])
     }
   }
   
-  /* Read configuration */
-  config_read();
+  /* SIGCHLD and SIGUSR1 reach the event loop through a signalfd; blocked
+     before the config may start Helper= processes and before the
+     launcher thread starts */
+  signal_fd = server_signals();
+  if (signal_fd < 0) perror("signalfd");
+  
+  /* Commands are spawned directly and reaped asynchronously. Set up
+     before the config, which may start Helper= processes. */
+  spawn_init();
+  
+  /* Read configuration, once for every display */
+  if (config_read() < 0) {
+    displays_disconnect();
+    return 1;
+  }
+  
+  /* Track the pointer instead of creating zone windows, if asked and the
+     server can. The pointer is tracked on one screen only. */
+  if (windowless && display_count > 1) {
+    fprintf(stderr, "Warning: --windowless serves a single display, using zone windows\n");
+    windowless = 0;
+  }
+  if (windowless && pointer_start(displays[0].connection, displays[0].screen) < 0) {
+    fprintf(stderr, "Warning: The X server has no XInput 2.2, using zone windows\n");
+    windowless = 0;
+  }
   
   /* Create windows for all enabled monitors */
-  server_create_windows(connection, screen);
+  server_create_windows();
+  
+  /* Log the zone events for --replay */
+  if (record_path && record_start(record_path) < 0) {
+    displays_disconnect();
+    return 1;
+  }
+  
+  /* Commands are spawned from a thread of their own so a slow spawn
+     never delays input handling */
+  launcher_start();
+  
+  /* Follow monitors being plugged, unplugged or rearranged */
+  for (d = 0; d < display_count; d++) monitors_watch(d);
+  
+  /* Zone events for status bars and overlays */
+  broadcast_start();
+  
+  /* Window manager state for the built-in @actions, on the first display */
+  ewmh_init(displays[0].connection, displays[0].screen);
   
   /* Event loop */
-  server_event_loop(connection);
+  server_event_loop(signal_fd);
+  
+  /* The next start finds no stale socket */
+  broadcast_stop();
   
-  /* Close connection to server */
-  xcb_disconnect(connection);
+  /* Close connections to the servers */
+  displays_disconnect();
   
   return 0;
 }
@@ -0,0 +1,482 @@
+/**************************************************************************
+*
+* fittsmon : map mouse button events on screen corners to commands.
+*             Shared declarations.
+*
+* Copyright (C) 2009 Yasen Atanasov (yasen.atanasov@gmail.com)
+* Modified 2025 by Eric Bakker (linuxbirdtweets@duck.com)
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License version 2
+* as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**************************************************************************/
+
+#ifndef FITTSMON_H
+#define FITTSMON_H
+
+/* INCLUDES */
+
+#include <xcb/xcb.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <time.h>
+
+
+/* MACROS */
+
+#define str_defined(str) ( (str && strlen(str) > 0) ? 1 : 0 )
+#define unless(a)        if ( ! (a) )
+#define command_bound(c) ( (c)->argv || (c)->internal )
+#define get_cmd(win,cmd,mods) (*bindings_lookup(bindings, (win), (cmd), (mods)))
+
+/* --trace spans, see trace.c; without it they cost a test */
+#define trace_now() ( tracing ? stats_now_ns() : 0 )
+#define trace_span(stage,start,win,event,detail) \
+  do { if (tracing) trace_add((stage), (start), (win), (event), (detail)); } while (0)
+
+/* CONSTANTS/OPTIONS */
+
+/* Screen Corners */
+enum eScreenCorners {
+  TopLeft, TopCenter, TopRight, Right, BottomRight, BottomCenter, BottomLeft, Left
+};
+
+/* Mouse button indexes for commands */
+enum eMouseButtons {
+  LeftButton, MiddleButton, RightButton, WheelUp, WheelDown, WheelUpOnce, WheelDownOnce, Enter, Leave,
+  WheelLeft, WheelRight, Button8, Button9, EVENT_COUNT
+};
+
+/* Modifiers a binding can ask for, as bits of the reduced mask; Lock,
+   NumLock and the rest are ignored */
+enum eModifiers {
+  MOD_SHIFT = 1, MOD_CTRL = 2, MOD_ALT = 4, MOD_SUPER = 8, MOD_COUNT = 16
+};
+#define modifiers_reduce(state) \
+  ( ((state) & XCB_MOD_MASK_SHIFT ? MOD_SHIFT : 0) | ((state) & XCB_MOD_MASK_CONTROL ? MOD_CTRL : 0) | \
+    ((state) & XCB_MOD_MASK_1 ? MOD_ALT : 0) | ((state) & XCB_MOD_MASK_4 ? MOD_SUPER : 0) )
+
+/* Built-in @actions, see ewmh.c */
+enum eInternalActions {
+  ACTION_NONE, ACTION_DESKTOP_NEXT, ACTION_DESKTOP_PREV, ACTION_SHOW_DESKTOP,
+  ACTION_CLOSE_WINDOW, ACTION_MINIMIZE_WINDOW
+};
+
+/* Event.Policy, what a launch does while the command is still running */
+enum eLaunchPolicies {
+  POLICY_PARALLEL, POLICY_SINGLE, POLICY_REPLACE, POLICY_QUEUE
+};
+
+/* Latency intervals and per-event counters, see stats.c */
+enum eStatsIntervals {
+  STATS_X_TO_DEQUEUE, STATS_DEQUEUE_TO_SPAWN, STATS_SPAWN_TO_EXIT, STATS_INTERVALS
+};
+enum eStatsCounters {
+  STATS_LAUNCHED, STATS_LIMITED, STATS_COALESCED, STATS_SPAWN_FAILED, STATS_DWELL_CANCELLED,
+  STATS_BUSY, STATS_REPLACED, STATS_COUNTERS
+};
+
+/* Pipeline stages --trace writes spans for, and what throttling decided */
+enum eTraceStages {
+  TRACE_RECEIVE, TRACE_LOOKUP, TRACE_THROTTLE, TRACE_SPAWN, TRACE_COMMAND, TRACE_VALIDATE, TRACE_STAGES
+};
+enum eTraceThrottle {
+  TRACE_PASSED, TRACE_LIMITED, TRACE_COALESCED, TRACE_HELD
+};
+
+/* Event broadcast clients served at once */
+#define BROADCAST_MAX_SUBSCRIBERS 32
+
+/* Room for a dispatch_format line: zone, modifiers, event, a 63-byte
+   monitor name and two numbers, with over 100 bytes left for the zone */
+#define EVENT_LINE_MAX 256
+
+/* Maximum length of a command line in fittsmonrc */
+#define MAX_COMMAND_LEN 200
+
+/* Longest gesture, in zone events */
+#define GESTURE_MAX_STEPS 16
+
+/* STRUCTS */
+
+/* A bound command, tokenized once when the config is read */
+struct str_command {
+  char *line;                 /* command line as written in fittsmonrc */
+  char **argv;                /* ready to spawn, NULL if unbound or rejected */
+  char shell;                 /* run through /bin/sh -c (explicit opt-in) */
+  char counted;               /* line uses the %n repeat-count placeholder */
+  char internal;              /* built-in @action run in-process, ACTION_NONE if spawned */
+  char helper;                /* Helper= process the event is written to, not spawned */
+  unsigned int coalesce_ms;   /* merge identical presses within this window, 0 = off */
+  unsigned int dwell_ms;      /* launch only if the pointer stays this long, 0 = at once */
+  float rate;                 /* token bucket refill, launches per second, 0 = unlimited */
+  unsigned int burst;         /* token bucket size */
+  char policy;                /* POLICY_*, while an instance is running */
+  unsigned short queue_max;   /* POLICY_QUEUE: launches that may wait */
+};
+
+/* Token bucket of one zone event. Counts the tokens taken rather than
+   those left, so a zeroed bucket is a full one. */
+struct str_bucket {
+  float used;
+  xcb_timestamp_t stamp; /* X server time of the last refill */
+};
+
+/* A resolved (zone, event) pair on its way to the launcher thread */
+struct str_action {
+  const struct str_command *command;
+  int win;
+  int event;
+  xcb_timestamp_t time;  /* X server time of the (first) event */
+  unsigned int count;    /* number of events this launch stands for */
+  long long dequeued;    /* CLOCK_MONOTONIC ns the (first) event was read at */
+  struct str_bindings *table; /* table command lives in, kept alive while queued */
+  char *const *envp;     /* environment of the zone's display, NULL for fittsmon's own */
+};
+
+/* A zone size or offset: pixels, or percent of the monitor's width or
+   height, whichever runs the same way */
+struct str_length {
+  float value;
+  char percent;
+};
+
+/* Geometry given in one fittsmonrc section: X, Y, Width and Height of a
+   zone, or CornerSize, EdgeThickness and EdgeLength in [Settings] */
+struct str_zone_rule {
+  char *monitor;                /* NULL in a section for every monitor */
+  int zone;                     /* -1 for the [Settings] sizes */
+  struct str_length values[4];
+  unsigned char set;            /* bit i: values[i] was given */
+};
+
+/* The zones every monitor has, the 8 positions followed by the zones
+   [Settings] Zones= names, and where fittsmonrc puts them */
+struct str_layout {
+  int zone_count;
+  char **names;                 /* the named zones, zone_count - 8 of them */
+  int rule_count;
+  struct str_zone_rule *rules;
+};
+
+/* A gesture from fittsmonrc, for one monitor: zone events in a row */
+struct str_gesture {
+  char *name;
+  int *steps;                   /* win * EVENT_COUNT + event of each step */
+  int length;
+  unsigned int within_ms;       /* first step to last, in X server time */
+  unsigned short command;       /* command index + 1 */
+  int also;                     /* index + 1 of another gesture ending in the same state, 0 = none */
+  unsigned int fired;           /* launches, for the stats dump */
+};
+
+/* The gestures compiled into a DFA whose symbols are the zone events
+   they use, see gesture.c */
+struct str_gestures {
+  int count;
+  struct str_gesture *list;
+  int symbol_count;
+  unsigned short *symbols;      /* [win * EVENT_COUNT + event] symbol, 0 = in no gesture; NULL if none */
+  int state_count;
+  int *next;                    /* [state * symbol_count + symbol - 1] */
+  int *accept;                  /* [state] index + 1 of the longest gesture ending here */
+  int *output;                  /* [state] shorter suffix state that accepts, 0 = none */
+};
+
+/* Every binding, by zone, event and modifiers. Built whole from
+   fittsmonrc and replaced whole on reload; reference counted so queued
+   actions can outlive a reload. Each distinct command is stored once and
+   the slots refer to it, so a default section bound on every monitor
+   costs one command plus two bytes per zone and modifier mask. A binding
+   without modifiers fills every mask no binding asks for by name, so a
+   press finds its command with one load whatever keys are held. */
+struct str_bindings {
+  int refs;
+  int zone_count;               /* zones the table was built for */
+  int command_count;
+  struct str_command *commands; /* interned commands */
+  unsigned short *slots;        /* [(zone * EVENT_COUNT + event) * MOD_COUNT + mods], command index + 1, 0 = unbound */
+  struct str_layout layout;     /* zones and geometry from the same file */
+  struct str_gestures gestures; /* multi-event bindings */
+};
+
+/* A Key=value line of fittsmonrc. Key and value point into the file's
+   buffer, cut out in place. */
+struct str_rc_entry {
+  const char *key;
+  char *value;
+  int line;
+  int group;
+  char reported;                /* a bad value was already reported */
+};
+
+/* A [section] and where its entries are; a section given twice is one */
+struct str_rc_group {
+  const char *name;
+  int line;
+  int first;                    /* entries[first .. first + count) */
+  int count;
+};
+
+/* fittsmonrc split into sections and keys, see rcfile.c */
+struct str_rcfile {
+  const char *path;
+  char *data;
+  size_t size;
+  char mapped;                  /* data is mapped rather than allocated */
+  int errors;                   /* problems reported so far */
+  int group_count;
+  struct str_rc_group *groups;
+  int entry_count;
+  struct str_rc_entry *entries;
+};
+
+/* Per-zone state the event path touches, kept small and dense */
+struct str_window_options {
+  xcb_window_t xcb_window; /* pointer to the newly created window.      */
+  char enabled;
+  int x;
+  int y;
+  int h;
+  int w;
+  struct str_bucket buckets[EVENT_COUNT]; /* launch rate limit per event */
+  unsigned int counts[EVENT_COUNT];       /* events seen, for the stats dump */
+};
+
+/* One XID lookup slot, xid 0 (None) marks an empty slot */
+struct str_zone_map_entry {
+  xcb_window_t xid;
+  int zone;
+  xcb_connection_t *connection; /* XIDs are only unique per connection */
+};
+
+/* Monitor info struct */
+typedef struct {
+    int x;
+    int y;
+    int width;
+    int height;
+    int primary;
+    char name[64];  // RandR name, after display/ on all but the first display
+    int enabled;  // Flag to indicate if this monitor is enabled by user args
+    int connected;  // Slot holds a live monitor; slots are reused after unplug
+    int display;  // Index in displays
+} MonitorInfo;
+
+/* An X screen fittsmon puts zones on, see display.c */
+struct str_display {
+  const char *name;             /* as given to --display, NULL for $DISPLAY */
+  char *host;                   /* host, display and screen number of name */
+  int number;
+  int screen_number;
+  xcb_connection_t *connection; /* shared by the screens of one X server */
+  int fd;
+  xcb_screen_t *screen;
+  int randr_event_base;         /* -1 when monitor changes are not watched */
+  char monitors_changed;
+  char lost;                    /* the connection broke */
+  char **environ;               /* for commands on its zones, NULL for fittsmon's own */
+};
+
+/* Shared by every unbound slot */
+extern const struct str_command command_unbound;
+
+static inline const struct str_command *
+bindings_lookup (const struct str_bindings *table, int win, int event, int mods)
+{
+  unsigned int slot;
+
+  if (win < 0 || win >= table->zone_count) return &command_unbound;
+  slot = table->slots[(win * EVENT_COUNT + event) * MOD_COUNT + mods];
+  return slot ? &table->commands[slot - 1] : &command_unbound;
+}
+
+/* Symbol of a zone event in the gesture DFA, 0 if no gesture uses it */
+static inline int
+gesture_symbol (const struct str_bindings *table, int win, int event)
+{
+  if (!table->gestures.symbols || win < 0 || win >= table->zone_count) return 0;
+  return table->gestures.symbols[win * EVENT_COUNT + event];
+}
+
+/*GLOBALS*/
+extern struct str_window_options *window_options; /* zones_per_monitor per monitor slot */
+extern int zones_per_monitor;
+extern MonitorInfo *monitors;
+extern int monitor_count;
+extern struct str_display *displays;
+extern int display_count;
+extern struct str_bindings *bindings;
+extern const char *section_names[8];
+extern const char *event_names[EVENT_COUNT];
+extern const char *modifier_names[4];
+extern int spawn_pidfds;
+extern int spawn_dry_run;
+extern int tracing;
+
+/* function prototypes */
+
+/* fittsmon.c */
+void init_options (int monitor_index);
+void zones_layout (int monitor_index);
+int  zones_resize (int count);
+void zones_configure (void);
+const char *zone_name (int zone);
+void server_create_zone_window(int i);
+void server_create_windows(void);
+void zone_map_rebuild (void);
+int  server_find_window(xcb_connection_t *connection, xcb_window_t win);
+void server_handle_event (xcb_connection_t *connection, xcb_generic_event_t *event);
+void server_event_loop (int signal_fd);
+int  server_watch (int fd, uint32_t events, void (*handle)(int fd, uint32_t events));
+void server_watch_modify (int fd, uint32_t events);
+void server_unwatch (int fd);
+int  get_all_monitors(xcb_connection_t *connection, xcb_screen_t *screen, MonitorInfo **list);
+int  monitors_reserve(int count);
+void monitors_watch(int display);
+void monitors_update(int display);
+int  enable_monitor_by_name(const char *name);
+void print_monitor_list();
+void server_print_stats (FILE *out);
+void server_print_zones (FILE *out);
+
+/* broadcast.c */
+int  broadcast_start (void);
+void broadcast_stop (void);
+void broadcast_event (int win, int event, int mods, xcb_timestamp_t time, unsigned int count);
+void broadcast_print_stats (FILE *out);
+int  broadcast_query (const char *request);
+
+/* config.c */
+struct str_bindings *bindings_new (int zone_count);
+void bindings_ref (struct str_bindings *table);
+void bindings_unref (struct str_bindings *table);
+struct str_bindings *config_read_file (const char *file_path);
+void fill_file(const char *file_path);
+int  config_read ();
+void config_reload (void);
+int  config_watch (void);
+void config_watch_handle (int fd, uint32_t events);
+unsigned int layout_lookup (const struct str_layout *layout, int zone, const char *monitor,
+                            struct str_length values[4]);
+
+/* display.c */
+int  display_add (const char *name);
+int  display_owns_connection (int d);
+void display_name_monitors (int d, MonitorInfo *list, int count);
+void displays_disconnect (void);
+
+/* dispatch.c */
+void dispatch_event (int win, int event, int mods, xcb_timestamp_t time);
+void dispatch_fire (int win, int event, int mods, xcb_timestamp_t time, long long dequeued);
+void dispatch_gesture (const struct str_command *command, int win, int event, xcb_timestamp_t time,
+                       long long dequeued);
+int  dispatch_timeout (void);
+void dispatch_expire (void);
+void dispatch_flush (void);
+int  dispatch_format (char *buf, size_t size, int win, int event, int mods, xcb_timestamp_t time,
+                      unsigned int count);
+
+/* dwell.c */
+int  dwell_init (void);
+void dwell_add (int win, int event, int mods, xcb_timestamp_t time, unsigned int ms);
+void dwell_cancel (int first_zone, int zone_count);
+void dwell_expire (int all);
+void dwell_handle (int fd, uint32_t events);
+
+/* ewmh.c */
+int  ewmh_action_parse (const char *name);
+void ewmh_init (xcb_connection_t *connection, xcb_screen_t *screen);
+void ewmh_property_notify (xcb_property_notify_event_t *event);
+void ewmh_poll (void);
+void ewmh_run (int action, xcb_timestamp_t time, unsigned int count);
+
+/* gesture.c */
+int  gesture_compile (struct str_gestures *gestures, int zone_count);
+void gesture_clear (struct str_gestures *gestures);
+void gesture_reset (void);
+void gesture_feed (int symbol, xcb_timestamp_t time, long long now);
+void gesture_print_stats (FILE *out);
+
+/* helper.c */
+void helpers_sync (const struct str_bindings *table);
+void helper_write (const struct str_command *command, int win, int event, int mods, xcb_timestamp_t time,
+                   unsigned int count);
+void helpers_reap (void);
+void helper_exited (pid_t pid);
+void helpers_print_stats (FILE *out);
+
+/* pointer.c */
+int  pointer_start (xcb_connection_t *connection, xcb_screen_t *screen);
+int  pointer_zone_at (int x, int y);
+void pointer_zones_changed (void);
+void pointer_forget (void);
+int  pointer_is_motion (const xcb_generic_event_t *event);
+int  pointer_handle_event (xcb_generic_event_t *event);
+void pointer_poll (void);
+
+/* launcher.c */
+int  launcher_start (void);
+void launcher_push (const struct str_action *action);
+void launcher_reap_untracked (void);
+void launcher_print_stats (FILE *out);
+
+/* trace.c */
+int  trace_start (const char *path);
+void trace_add (int stage, long long start, int win, int event, int detail);
+void trace_wake (void);
+void trace_flush (void);
+int  trace_watch_fd (void);
+void trace_handle (int fd, uint32_t events);
+void trace_print_stats (FILE *out);
+
+/* record.c */
+int  record_start (const char *path);
+void record_flush (void);
+void record_stop (const char *reason);
+void record_event (int type, int detail, int state, int zone, xcb_timestamp_t time);
+int  replay_open (const char *path);
+int  replay_run (int fast);
+
+/* rcfile.c */
+int  rc_open (struct str_rcfile *rc, const char *path, int (*known_key)(const char *key, size_t len));
+void rc_close (struct str_rcfile *rc);
+int  rc_group (const struct str_rcfile *rc, const char *name);
+const struct str_rc_entry *rc_lookup (const struct str_rcfile *rc, int group, const char *key, const char *option);
+char *rc_value (const struct str_rcfile *rc, int group, const char *key);
+int  rc_boolean (struct str_rcfile *rc, int group, const char *key, const char *option);
+double rc_number (struct str_rcfile *rc, int group, const char *key, const char *option, double fallback);
+char *rc_list_next (char **cursor);
+void rc_bad_value (struct str_rcfile *rc, const struct str_rc_entry *entry, const char *expected);
+
+/* spawn.c */
+void spawn_init (void);
+void spawn_reap (void);
+int  spawn_pidfd (pid_t pid);
+pid_t spawn_command (const struct str_command *command, unsigned int count, char *const envp[]);
+pid_t spawn_helper (const struct str_command *command, int *fd);
+int  command_parse (struct str_command *command, const char *line, int shell);
+void command_clear (struct str_command *command);
+int  is_safe_command (char *const argv[]);
+
+/* stats.c */
+long long stats_now_ns (void);
+void stats_record (int interval, long long ns);
+void stats_count (int counter, int event, unsigned int n);
+void stats_dequeued (int win, int event, xcb_timestamp_t time, long long now);
+void stats_spawned (pid_t pid, long long dequeued, long long started);
+void stats_exited (pid_t pid);
+void stats_print (FILE *out);
+
+#endif
@@ -0,0 +1,209 @@
+/**************************************************************************
+*
+* fittsmon : map mouse button events on screen corners to commands.
+*             Gestures: bindings for a sequence of zone events.
+*
+* Copyright (C) 2009 Yasen Atanasov (yasen.atanasov@gmail.com)
+* Modified 2025 by Eric Bakker (linuxbirdtweets@duck.com)
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License version 2
+* as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**************************************************************************/
+
+/*
+ * A gesture is a sequence of zone events, such as two LeftButton presses
+ * on BottomLeft, that launches a command when its steps arrive in a row
+ * within a time limit.
+ *
+ * When fittsmonrc is read, the gestures are compiled into one DFA (an
+ * Aho-Corasick automaton with every transition filled in). Its symbols are
+ * the zone events some gesture uses; all other events never reach it, so
+ * plain bindings cost no more than an array lookup. A symbol moves the DFA
+ * with one table lookup. A state stands for the longest run of recent
+ * events that starts some gesture, so a false start does not hide a
+ * gesture that begins in the middle of it.
+ *
+ * Time limits are checked in X server time when a gesture completes,
+ * against the timestamps of the last few events. The first gesture to
+ * complete wins, and its events do not count towards another one.
+ */
+
+
+/* INCLUDES */
+
+#include "fittsmon.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+
+/* CONSTANTS/OPTIONS */
+
+/* Transition table entries a config may compile to, 4 MB */
+#define GESTURE_MAX_TABLE (1 << 20)
+
+/* GLOBALS */
+
+static int state = 0;
+static xcb_timestamp_t times[GESTURE_MAX_STEPS];  /* of the latest symbols, a ring */
+static unsigned int seen = 0;
+
+/* implementations */
+
+void
+gesture_clear (struct str_gestures *gestures)
+{
+  for (int i = 0; i < gestures->count; i++) {
+    free(gestures->list[i].name);
+    free(gestures->list[i].steps);
+  }
+  free(gestures->list);
+  free(gestures->symbols);
+  free(gestures->next);
+  free(gestures->accept);
+  free(gestures->output);
+  memset(gestures, 0, sizeof(*gestures));
+}
+
+/* Build the DFA for the gestures in list, with steps on zones below
+   zone_count. Returns -1 if it would not fit. */
+int
+gesture_compile (struct str_gestures *gestures, int zone_count)
+{
+  int max_states = 1, symbols = 0;
+  int *fail = NULL, *queue = NULL;
+  int i, k, a, head, tail, count;
+
+  unless (gestures->count) return 0;
+
+  unless ((gestures->symbols = calloc((size_t)zone_count * EVENT_COUNT, sizeof(unsigned short)))) return -1;
+  for (i = 0; i < gestures->count; i++) {
+    for (k = 0; k < gestures->list[i].length; k++) {
+      int step = gestures->list[i].steps[k];
+
+      if (gestures->symbols[step]) continue;
+      if (symbols == 0xffff) return -1;
+      gestures->symbols[step] = ++symbols;
+    }
+    max_states += gestures->list[i].length;
+  }
+  gestures->symbol_count = symbols;
+
+  if ((long long)max_states * symbols > GESTURE_MAX_TABLE) return -1;
+
+  gestures->next = calloc((size_t)max_states * symbols, sizeof(int));
+  gestures->accept = calloc(max_states, sizeof(int));
+  gestures->output = calloc(max_states, sizeof(int));
+  fail = calloc(max_states, sizeof(int));
+  queue = malloc(max_states * sizeof(int));
+  unless (gestures->next && gestures->accept && gestures->output && fail && queue) {
+    free(fail);
+    free(queue);
+    return -1;
+  }
+
+  /* A trie of the sequences; 0 is the root, so no edge leads to it yet */
+  count = 1;
+  for (i = 0; i < gestures->count; i++) {
+    struct str_gesture *gesture = &gestures->list[i];
+    int s = 0;
+
+    for (k = 0; k < gesture->length; k++) {
+      int *edge = &gestures->next[s * symbols + gestures->symbols[gesture->steps[k]] - 1];
+
+      unless (*edge) *edge = count++;
+      s = *edge;
+    }
+    gesture->also = gestures->accept[s];
+    gestures->accept[s] = i + 1;
+  }
+  gestures->state_count = count;
+
+  /* Breadth first, so a state's failure state is done before it: missing
+     edges take the failure state's, and accepting suffixes are linked */
+  head = tail = 0;
+  for (a = 0; a < symbols; a++) {
+    if (gestures->next[a]) queue[tail++] = gestures->next[a];
+  }
+  while (head < tail) {
+    int s = queue[head++];
+
+    for (a = 0; a < symbols; a++) {
+      int *edge = &gestures->next[s * symbols + a];
+      int f = gestures->next[fail[s] * symbols + a];
+
+      unless (*edge) {
+        *edge = f;
+        continue;
+      }
+      fail[*edge] = f;
+      gestures->output[*edge] = gestures->accept[f] ? f : gestures->output[f];
+      queue[tail++] = *edge;
+    }
+  }
+
+  free(fail);
+  free(queue);
+  return 0;
+}
+
+/* Start over, e.g. when a new binding table is installed */
+void
+gesture_reset (void)
+{
+  state = 0;
+  seen = 0;
+}
+
+/* Move the DFA on a zone event's symbol, and launch the gesture it
+   completes, if any is within its time limit */
+void
+gesture_feed (int symbol, xcb_timestamp_t time, long long now)
+{
+  struct str_gestures *gestures = &bindings->gestures;
+
+  times[seen++ % GESTURE_MAX_STEPS] = time;
+  state = gestures->next[state * gestures->symbol_count + symbol - 1];
+
+  /* Longest gesture first, then those ending in a suffix of it */
+  for (int s = gestures->accept[state] ? state : gestures->output[state]; s; s = gestures->output[s]) {
+    for (int i = gestures->accept[s]; i; i = gestures->list[i - 1].also) {
+      struct str_gesture *gesture = &gestures->list[i - 1];
+      int last = gesture->steps[gesture->length - 1];
+
+      if ((xcb_timestamp_t)(time - times[(seen - gesture->length) % GESTURE_MAX_STEPS]) > gesture->within_ms) {
+        continue;
+      }
+
+      gesture->fired++;
+      state = 0;
+      dispatch_gesture(&bindings->commands[gesture->command - 1], last / EVENT_COUNT, last % EVENT_COUNT,
+                       time, now);
+      return;
+    }
+  }
+}
+
+/* Launches per gesture and monitor */
+void
+gesture_print_stats (FILE *out)
+{
+  const struct str_gestures *gestures = &bindings->gestures;
+
+  for (int i = 0; i < gestures->count; i++) {
+    const struct str_gesture *gesture = &gestures->list[i];
+
+    fprintf(out, "Gesture %s (%s): fired %u\n", gesture->name,
+            monitors[gesture->steps[0] / EVENT_COUNT / zones_per_monitor].name, gesture->fired);
+  }
+  fflush(out);
+}
@@ -0,0 +1,244 @@
+/**************************************************************************
+*
+* fittsmon : map mouse button events on screen corners to commands.
+*             Long-lived Helper= processes fed one line per event.
+*
+* Copyright (C) 2009 Yasen Atanasov (yasen.atanasov@gmail.com)
+* Modified 2025 by Eric Bakker (linuxbirdtweets@duck.com)
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License version 2
+* as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**************************************************************************/
+
+/*
+ * A helper is started once, when a config naming it is installed, and
+ * reads events from its stdin:
+ *
+ *     <zone> <event> <monitor> <X timestamp> <repeat count>\n
+ *
+ * The pipe is non-blocking. A line is far below PIPE_BUF, so it is
+ * written whole or not at all: when the helper falls behind and the pipe
+ * is full, the line is dropped instead of stalling the event loop. A
+ * helper that died is noticed through EPIPE and started again, at most
+ * once a second. Stopped helpers are remembered until they are reaped.
+ */
+
+
+/* INCLUDES */
+
+#include "fittsmon.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+/* CONSTANTS/OPTIONS */
+
+/* Minimum time between two starts of the same helper */
+#define HELPER_RESTART_MS 1000
+
+/* STRUCTS */
+
+struct str_helper {
+  struct str_command command; /* own copy, binding tables come and go */
+  int fd;                     /* write end of its stdin, -1 when not running */
+  pid_t pid;                  /* 0 once reaped */
+  char used;                  /* referenced by the installed binding table */
+  long long started;          /* CLOCK_MONOTONIC ms of the last start */
+  unsigned long long written;
+  unsigned long long dropped;
+};
+
+/* GLOBALS */
+
+static struct str_helper *helpers = NULL;
+static int helper_count = 0;
+
+/* Helpers told to exit that were not reaped yet */
+static pid_t *stopped = NULL;
+static int stopped_count = 0;
+
+/* implementations */
+
+static long long
+helper_now_ms (void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static struct str_helper *
+helper_find (const struct str_command *command)
+{
+  for (int i = 0; i < helper_count; i++) {
+    if (helpers[i].command.shell == command->shell && strcmp(helpers[i].command.line, command->line) == 0) {
+      return &helpers[i];
+    }
+  }
+  return NULL;
+}
+
+static void
+helper_start (struct str_helper *helper)
+{
+  helper->started = helper_now_ms();
+  helper->pid = spawn_helper(&helper->command, &helper->fd);
+  if (helper->pid < 0) {
+    helper->pid = 0;
+    helper->fd = -1;
+    return;
+  }
+  printf("Started helper %d: %s\n", (int)helper->pid, helper->command.line);
+}
+
+/* Closing its stdin is the helper's signal to exit. Its pid is kept so
+   it can still be reaped. */
+static void
+helper_stop (struct str_helper *helper)
+{
+  if (helper->fd >= 0) close(helper->fd);
+  helper->fd = -1;
+
+  if (helper->pid > 0) {
+    pid_t *grown = realloc(stopped, (stopped_count + 1) * sizeof(pid_t));
+
+    if (grown) {
+      stopped = grown;
+      stopped[stopped_count++] = helper->pid;
+    }
+  }
+  helper->pid = 0;
+}
+
+/* Reap the helpers that exited, running or stopped, each by its pid */
+void
+helpers_reap (void)
+{
+  int i, j;
+
+  for (i = 0; i < helper_count; i++) {
+    if (helpers[i].pid > 0 && waitpid(helpers[i].pid, NULL, WNOHANG) != 0) helpers[i].pid = 0;
+  }
+
+  for (i = j = 0; i < stopped_count; i++) {
+    if (waitpid(stopped[i], NULL, WNOHANG) == 0) stopped[j++] = stopped[i];
+  }
+  stopped_count = j;
+}
+
+/* A child reaped by someone else was this helper */
+void
+helper_exited (pid_t pid)
+{
+  int i, j;
+
+  for (i = 0; i < helper_count; i++) {
+    if (helpers[i].pid == pid) helpers[i].pid = 0;
+  }
+
+  for (i = j = 0; i < stopped_count; i++) {
+    if (stopped[i] != pid) stopped[j++] = stopped[i];
+  }
+  stopped_count = j;
+}
+
+/* Start the helpers a newly installed binding table refers to and stop
+   those it no longer does. Helpers present in both keep running. */
+void
+helpers_sync (const struct str_bindings *table)
+{
+  int i, j;
+
+  for (i = 0; i < helper_count; i++) helpers[i].used = 0;
+
+  for (i = 0; i < table->command_count; i++) {
+    const struct str_command *command = &table->commands[i];
+    struct str_helper *helper;
+
+    unless (command->helper && command->argv) continue;
+
+    unless ((helper = helper_find(command))) {
+      struct str_helper *grown = realloc(helpers, (helper_count + 1) * sizeof(struct str_helper));
+
+      unless (grown) continue;
+      helpers = grown;
+      helper = &helpers[helper_count++];
+      memset(helper, 0, sizeof(*helper));
+      command_parse(&helper->command, command->line, command->shell);
+      helper_start(helper);
+    }
+    helper->used = 1;
+  }
+
+  for (i = j = 0; i < helper_count; i++) {
+    if (helpers[i].used) {
+      helpers[j++] = helpers[i];
+      continue;
+    }
+    helper_stop(&helpers[i]);
+    command_clear(&helpers[i].command);
+  }
+  helper_count = j;
+}
+
+/* Hand one event to the helper command stands for. Never blocks. */
+void
+helper_write (const struct str_command *command, int win, int event, int mods, xcb_timestamp_t time,
+              unsigned int count)
+{
+  struct str_helper *helper = helper_find(command);
+  char line[EVENT_LINE_MAX];
+  int len;
+
+  unless (helper) return;
+
+  if ((len = dispatch_format(line, sizeof(line), win, event, mods, time, count)) < 0) {
+    helper->dropped++;
+    return;
+  }
+
+  for (int attempt = 0; attempt < 2; attempt++) {
+    if (helper->fd < 0) {
+      if (helper_now_ms() - helper->started < HELPER_RESTART_MS) break;
+      helper_start(helper);
+      if (helper->fd < 0) break;
+    }
+
+    if (write(helper->fd, line, len) == len) {
+      helper->written++;
+      return;
+    }
+
+    unless (errno == EPIPE) break;
+
+    /* It died: restart and try once more */
+    fprintf(stderr, "Warning: Helper %d exited: %s\n", (int)helper->pid, helper->command.line);
+    helper_stop(helper);
+  }
+
+  helper->dropped++;
+}
+
+void
+helpers_print_stats (FILE *out)
+{
+  for (int i = 0; i < helper_count; i++) {
+    fprintf(out, "Helper %s: %s, written %llu, dropped %llu\n", helpers[i].command.line,
+            helpers[i].fd >= 0 ? "running" : "stopped", helpers[i].written, helpers[i].dropped);
+  }
+  fflush(out);
+}
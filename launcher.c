@@ -0,0 +1,586 @@
+/**************************************************************************
+*
+* fittsmon : map mouse button events on screen corners to commands.
+*             Launcher thread and the lock-free queue feeding it.
+*
+* Copyright (C) 2009 Yasen Atanasov (yasen.atanasov@gmail.com)
+* Modified 2025 by Eric Bakker (linuxbirdtweets@duck.com)
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License version 2
+* as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**************************************************************************/
+
+/*
+ * The X reader (producer) resolves events to actions and pushes them on a
+ * bounded single-producer/single-consumer ring; the launcher thread
+ * (consumer) pops them and spawns the commands, so a slow spawn never
+ * holds up xcb_wait_for_event.
+ *
+ * Each slot carries one 64-bit state word: the queue position it holds in
+ * the high half and the pending repeat count in the low half. An entry is
+ * claimed by swapping its count to 0 with a compare-and-swap on that word,
+ * which lets the producer merge into, or drop, an entry the consumer has
+ * not claimed yet without a lock.
+ *
+ * Overflow policy, when the ring is full: an action identical to the newest
+ * queued one is merged into it (its repeat count grows); otherwise the
+ * oldest queued action is dropped.
+ *
+ * The launcher also keeps every command it started until it exits. It
+ * sleeps in epoll on the wakeup eventfd and a pidfd per child, and reaps
+ * a child as soon as its pidfd is readable, so the number of instances of
+ * each command running is known exactly. That is what a binding's Policy
+ * acts on: parallel starts another instance regardless, single skips the
+ * launch while one runs, replace sends the running ones SIGTERM first and
+ * queue:N keeps up to N launches waiting for the running one to exit.
+ */
+
+
+/* INCLUDES */
+
+#include "fittsmon.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifndef P_PIDFD
+#define P_PIDFD 3
+#endif
+
+
+/* CONSTANTS/OPTIONS */
+
+/* Queue capacity, must be a power of two */
+#define LAUNCH_QUEUE_SIZE 256
+#define LAUNCH_QUEUE_MASK (LAUNCH_QUEUE_SIZE - 1)
+
+#define slot_state(pos,count) ( ((uint64_t)(uint32_t)(pos) << 32) | (uint32_t)(count) )
+#define state_pos(state)      ( (uint32_t)((state) >> 32) )
+#define state_count(state)    ( (uint32_t)(state) )
+
+/* epoll events taken per wakeup */
+#define LAUNCHER_EPOLL_EVENTS 16
+
+/* How often children without a pidfd are checked on, ms */
+#define LAUNCHER_POLL_MS 1000
+
+/* STRUCTS */
+
+struct str_slot {
+  uint64_t state;                     /* position << 32 | count, count 0 = claimed */
+  const struct str_command *command;
+  int win;
+  int event;
+  xcb_timestamp_t time;
+  long long dequeued;
+  struct str_bindings *table;         /* reference held while the entry is queued */
+  char *const *envp;
+};
+
+struct str_launch_queue {
+  struct str_slot slots[LAUNCH_QUEUE_SIZE];
+  uint32_t head;      /* next position to fill, written by the producer only */
+  uint32_t tail;      /* oldest position not yet released */
+  uint32_t max_depth; /* high-water mark, producer only */
+  uint64_t pushed;
+  uint64_t merged;
+  uint64_t dropped;
+  int wakeup_fd;      /* eventfd the consumer sleeps on */
+};
+
+/* A command the launcher started and has not reaped yet */
+struct str_child {
+  pid_t pid;
+  int pidfd;                          /* -1: checked on with waitpid instead */
+  const struct str_command *command;
+  struct str_bindings *table;         /* reference held while it runs */
+  int win, event;                     /* for --trace */
+  long long started;
+};
+
+/* GLOBALS */
+
+static struct str_launch_queue queue;
+static pthread_t launcher_thread;
+static int launcher_running = 0;
+
+/* Owned by the launcher thread, or by the X reader when there is none */
+static int launcher_epoll_fd = -1;
+static struct str_child *children = NULL;
+static int child_count = 0;
+static int child_capacity = 0;
+static int untracked_count = 0;       /* children without a pidfd */
+static struct str_action *waiting = NULL; /* Policy=queue:N launches, oldest first */
+static int waiting_count = 0;
+static int waiting_capacity = 0;
+
+/* Read by launcher_print_stats */
+static int children_running = 0;
+static int children_max = 0;
+
+/* implementations */
+
+/* Instances of the same command, from this binding table or an older one */
+static int
+launcher_same (const struct str_command *a, const struct str_command *b)
+{
+  return a == b || (a->shell == b->shell && strcmp(a->line, b->line) == 0);
+}
+
+/* Start an action's command. With pidfds the child is kept until it
+   exits; room for it is made first, so a child is never left unreaped.
+   Returns the pid, -1 on failure. */
+static pid_t
+launcher_spawn (const struct str_action *action)
+{
+  long long started;
+  struct str_child *child;
+  pid_t pid;
+
+  if (spawn_pidfds && child_count == child_capacity) {
+    int capacity = child_capacity ? child_capacity * 2 : 16;
+    struct str_child *grown = realloc(children, capacity * sizeof(struct str_child));
+
+    unless (grown) {
+      stats_count(STATS_SPAWN_FAILED, action->event, 1);
+      return -1;
+    }
+    children = grown;
+    child_capacity = capacity;
+  }
+
+  started = stats_now_ns();
+  pid = spawn_command(action->command, action->count, action->envp);
+
+  /* A dry run has no child to wait for */
+  stats_spawned(pid ? pid : -1, action->dequeued, started);
+  trace_span(TRACE_SPAWN, started, action->win, action->event, pid);
+  if (pid < 0) {
+    stats_count(STATS_SPAWN_FAILED, action->event, 1);
+    return -1;
+  }
+  unless (spawn_pidfds && pid) return pid;
+
+  child = &children[child_count++];
+  child->pid = pid;
+  child->command = action->command;
+  child->table = action->table;
+  child->win = action->win;
+  child->event = action->event;
+  child->started = started;
+  bindings_ref(child->table);
+
+  child->pidfd = spawn_pidfd(pid);
+  if (child->pidfd >= 0 && launcher_epoll_fd >= 0) {
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = child->pidfd };
+
+    if (epoll_ctl(launcher_epoll_fd, EPOLL_CTL_ADD, child->pidfd, &ev) < 0) {
+      close(child->pidfd);
+      child->pidfd = -1;
+    }
+  } else if (child->pidfd >= 0) {
+    close(child->pidfd);
+    child->pidfd = -1;
+  }
+  if (child->pidfd < 0) untracked_count++;
+
+  __atomic_store_n(&children_running, child_count, __ATOMIC_RELAXED);
+  if (child_count > children_max) __atomic_store_n(&children_max, child_count, __ATOMIC_RELAXED);
+  return pid;
+}
+
+/* Start the oldest launch waiting for an instance of command to exit */
+static void
+launcher_next (const struct str_command *command)
+{
+  for (int i = 0; i < waiting_count; i++) {
+    struct str_action action = waiting[i];
+
+    unless (launcher_same(action.command, command)) continue;
+
+    memmove(&waiting[i], &waiting[i + 1], (waiting_count - i - 1) * sizeof(struct str_action));
+    waiting_count--;
+    i--;
+
+    pid_t pid = launcher_spawn(&action);
+    bindings_unref(action.table);
+    if (pid >= 0) return;
+  }
+}
+
+/* Reap children[i] if it exited: its binding table is let go and a launch
+   waiting for it, if any, is started. Returns 1 if it was reaped. */
+static int
+launcher_reap (int i)
+{
+  struct str_child child = children[i];
+  siginfo_t info;
+
+  if (child.pidfd >= 0) {
+    info.si_pid = 0;
+    if (waitid(P_PIDFD, child.pidfd, &info, WEXITED | WNOHANG) == 0 && info.si_pid == 0) return 0;
+    close(child.pidfd);
+  } else {
+    if (waitpid(child.pid, NULL, WNOHANG) == 0) return 0;
+    untracked_count--;
+  }
+
+  stats_exited(child.pid);
+  trace_span(TRACE_COMMAND, child.started, child.win, child.event, child.pid);
+  children[i] = children[--child_count];
+  __atomic_store_n(&children_running, child_count, __ATOMIC_RELAXED);
+
+  launcher_next(child.command);
+  bindings_unref(child.table);
+  return 1;
+}
+
+/* Check on the children without a pidfd */
+static void
+launcher_poll (void)
+{
+  for (int i = child_count - 1; i >= 0; i--) {
+    if (children[i].pidfd < 0) launcher_reap(i);
+  }
+}
+
+/* Handle the pidfds epoll reported readable */
+static void
+launcher_reap_ready (const struct epoll_event *ready, int n)
+{
+  for (int k = 0; k < n; k++) {
+    for (int i = 0; i < child_count; i++) {
+      if (children[i].pidfd == ready[k].data.fd) {
+        launcher_reap(i);
+        break;
+      }
+    }
+  }
+}
+
+/* Apply the command's Policy to a launch */
+static void
+launcher_run (const struct str_action *action)
+{
+  const struct str_command *command = action->command;
+  int running = 0, queued = 0, i;
+
+  if (untracked_count) launcher_poll();
+
+  if (command->policy != POLICY_PARALLEL && !spawn_pidfds) {
+    static char warned = 0;
+
+    unless (warned) fprintf(stderr, "Warning: No pidfd support, every Policy acts as parallel\n");
+    warned = 1;
+  }
+
+  if (command->policy == POLICY_PARALLEL || !spawn_pidfds) {
+    launcher_spawn(action);
+    return;
+  }
+
+  for (i = 0; i < child_count; i++) running += launcher_same(children[i].command, command);
+
+  switch (command->policy) {
+  case POLICY_SINGLE:
+    if (running) {
+      stats_count(STATS_BUSY, action->event, 1);
+      return;
+    }
+    break;
+
+  case POLICY_REPLACE:
+    for (i = 0; i < child_count; i++) {
+      unless (launcher_same(children[i].command, command)) continue;
+      if (children[i].pidfd >= 0) syscall(SYS_pidfd_send_signal, children[i].pidfd, SIGTERM, NULL, 0);
+      else kill(children[i].pid, SIGTERM);
+    }
+    if (running) stats_count(STATS_REPLACED, action->event, 1);
+    break;
+
+  case POLICY_QUEUE:
+    unless (running) break;
+
+    for (i = 0; i < waiting_count; i++) queued += launcher_same(waiting[i].command, command);
+    if (queued >= command->queue_max) {
+      stats_count(STATS_BUSY, action->event, 1);
+      return;
+    }
+
+    if (waiting_count == waiting_capacity) {
+      int capacity = waiting_capacity ? waiting_capacity * 2 : 8;
+      struct str_action *grown = realloc(waiting, capacity * sizeof(struct str_action));
+
+      unless (grown) {
+        stats_count(STATS_BUSY, action->event, 1);
+        return;
+      }
+      waiting = grown;
+      waiting_capacity = capacity;
+    }
+    waiting[waiting_count++] = *action;
+    bindings_ref(action->table);
+    return;
+  }
+
+  launcher_spawn(action);
+}
+
+/* Claim the entry at position pos if nobody has yet. Returns its count,
+   0 if it was already claimed. */
+static uint32_t
+queue_claim (struct str_slot *slot, uint32_t pos, uint64_t state)
+{
+  if (state_pos(state) != pos || state_count(state) == 0) return 0;
+  if (__atomic_compare_exchange_n(&slot->state, &state, slot_state(pos, 0), 0,
+                                  __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    return state_count(state);
+  }
+  return 0;
+}
+
+/* Producer side of the overflow policy. Returns 1 if the action was
+   merged into the newest queued entry and needs no slot of its own. */
+static int
+queue_make_room (const struct str_action *action)
+{
+  uint32_t head = queue.head;
+  struct str_slot *slot = &queue.slots[(head - 1) & LAUNCH_QUEUE_MASK];
+  uint64_t state = __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE);
+
+  if (state_pos(state) == head - 1 && state_count(state) > 0 &&
+      slot->command == action->command && slot->win == action->win && slot->event == action->event &&
+      __atomic_compare_exchange_n(&slot->state, &state, state + action->count, 0,
+                                  __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    __atomic_add_fetch(&queue.merged, 1, __ATOMIC_RELAXED);
+    return 1;
+  }
+
+  while (head - __atomic_load_n(&queue.tail, __ATOMIC_ACQUIRE) >= LAUNCH_QUEUE_SIZE) {
+    uint32_t tail = __atomic_load_n(&queue.tail, __ATOMIC_ACQUIRE);
+
+    slot = &queue.slots[tail & LAUNCH_QUEUE_MASK];
+    state = __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE);
+    if (queue_claim(slot, tail, state)) {
+      __atomic_add_fetch(&queue.dropped, 1, __ATOMIC_RELAXED);
+      bindings_unref(slot->table);
+    }
+    __atomic_compare_exchange_n(&queue.tail, &tail, tail + 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+  }
+
+  return 0;
+}
+
+/* Hand an action to the launcher thread. Never blocks. */
+void
+launcher_push (const struct str_action *action)
+{
+  uint32_t head = queue.head;
+  uint64_t one = 1;
+  uint32_t depth;
+
+  unless (action->command && action->command->argv) return;
+
+  /* Without the thread we fall back to spawning from the reader */
+  unless (launcher_running) {
+    launcher_run(action);
+    return;
+  }
+
+  __atomic_add_fetch(&queue.pushed, 1, __ATOMIC_RELAXED);
+
+  if (head - __atomic_load_n(&queue.tail, __ATOMIC_ACQUIRE) >= LAUNCH_QUEUE_SIZE &&
+      queue_make_room(action)) {
+    return;
+  }
+
+  /* The command lives in the binding table, which a reload may replace
+     before the launcher gets to it */
+  bindings_ref(action->table);
+
+  struct str_slot *slot = &queue.slots[head & LAUNCH_QUEUE_MASK];
+  __atomic_store_n(&slot->command, action->command, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->table, action->table, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->win, action->win, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->event, action->event, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->time, action->time, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->dequeued, action->dequeued, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->envp, action->envp, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->state, slot_state(head, action->count), __ATOMIC_RELEASE);
+  __atomic_store_n(&queue.head, head + 1, __ATOMIC_RELEASE);
+
+  depth = head + 1 - __atomic_load_n(&queue.tail, __ATOMIC_ACQUIRE);
+  if (depth > queue.max_depth) __atomic_store_n(&queue.max_depth, depth, __ATOMIC_RELAXED);
+
+  if (write(queue.wakeup_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+    perror("launcher wakeup");
+  }
+}
+
+/* Consumer side: take the oldest unclaimed action. Returns 0 when empty. */
+static int
+queue_pop (struct str_action *action)
+{
+  for (;;) {
+    uint32_t tail = __atomic_load_n(&queue.tail, __ATOMIC_ACQUIRE);
+    struct str_slot *slot = &queue.slots[tail & LAUNCH_QUEUE_MASK];
+    uint64_t state;
+    uint32_t count;
+
+    if (tail == __atomic_load_n(&queue.head, __ATOMIC_ACQUIRE)) return 0;
+
+    state = __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE);
+    action->command = __atomic_load_n(&slot->command, __ATOMIC_RELAXED);
+    action->win = __atomic_load_n(&slot->win, __ATOMIC_RELAXED);
+    action->event = __atomic_load_n(&slot->event, __ATOMIC_RELAXED);
+    action->time = __atomic_load_n(&slot->time, __ATOMIC_RELAXED);
+    action->dequeued = __atomic_load_n(&slot->dequeued, __ATOMIC_RELAXED);
+    action->table = __atomic_load_n(&slot->table, __ATOMIC_RELAXED);
+    action->envp = __atomic_load_n(&slot->envp, __ATOMIC_RELAXED);
+
+    /* A claim lost to a merge, which only raised the count, is tried
+       again. Otherwise the producer dropped or reused the entry: the copy
+       above is discarded and we move on. */
+    unless ((count = queue_claim(slot, tail, state))) {
+      uint64_t again = __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE);
+
+      if (state_pos(again) == tail && state_count(again) > 0) continue;
+    }
+    if (state_pos(state) == tail) {
+      __atomic_compare_exchange_n(&queue.tail, &tail, tail + 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+    }
+
+    if (count) {
+      action->count = count;
+      return 1;
+    }
+  }
+}
+
+static void *
+launcher_main (void *arg)
+{
+  struct epoll_event ready[LAUNCHER_EPOLL_EVENTS];
+  struct str_action action;
+  uint64_t wakeups;
+  int n;
+
+  for (;;) {
+    while (queue_pop(&action)) {
+      launcher_run(&action);
+      bindings_unref(action.table);
+    }
+    trace_wake();
+
+    n = epoll_wait(launcher_epoll_fd, ready, LAUNCHER_EPOLL_EVENTS, untracked_count ? LAUNCHER_POLL_MS : -1);
+    if (n < 0 && errno != EINTR) {
+      perror("launcher");
+      return NULL;
+    }
+
+    for (int i = 0; i < n; i++) {
+      if (ready[i].data.fd == queue.wakeup_fd && read(queue.wakeup_fd, &wakeups, sizeof(wakeups)) < 0 &&
+          errno != EINTR) {
+        perror("launcher");
+        return NULL;
+      }
+    }
+    launcher_reap_ready(ready, n);
+    if (untracked_count) launcher_poll();
+  }
+}
+
+/* Without the thread, the X reader's event loop watches the children */
+static void
+launcher_handle (int fd, uint32_t events)
+{
+  struct epoll_event ready[LAUNCHER_EPOLL_EVENTS];
+  int n = epoll_wait(fd, ready, LAUNCHER_EPOLL_EVENTS, 0);
+
+  if (n > 0) launcher_reap_ready(ready, n);
+}
+
+/* SIGCHLD: without the thread, nothing else checks on the children no
+   pidfd watches until the next launch */
+void
+launcher_reap_untracked (void)
+{
+  if (!launcher_running && untracked_count) launcher_poll();
+}
+
+/* Start the launcher thread. Returns 0 on success. */
+int
+launcher_start (void)
+{
+  struct epoll_event ev = { .events = EPOLLIN };
+  sigset_t all, old;
+  int err;
+
+  queue.wakeup_fd = eventfd(0, EFD_CLOEXEC);
+  if (queue.wakeup_fd < 0) {
+    perror("eventfd");
+    return -1;
+  }
+
+  ev.data.fd = queue.wakeup_fd;
+  launcher_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (launcher_epoll_fd < 0 || epoll_ctl(launcher_epoll_fd, EPOLL_CTL_ADD, queue.wakeup_fd, &ev) < 0) {
+    perror("launcher epoll");
+    if (launcher_epoll_fd >= 0) close(launcher_epoll_fd);
+    launcher_epoll_fd = -1;
+    close(queue.wakeup_fd);
+    return -1;
+  }
+
+  /* Signals are handled by the X reader thread only */
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  err = pthread_create(&launcher_thread, NULL, launcher_main, NULL);
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+  if (err != 0) {
+    fprintf(stderr, "Failed to start launcher thread: %s\n", strerror(err));
+    server_watch(launcher_epoll_fd, EPOLLIN, launcher_handle);
+    return -1;
+  }
+
+  launcher_running = 1;
+  return 0;
+}
+
+/* Report queue backpressure */
+void
+launcher_print_stats (FILE *out)
+{
+  uint32_t head = __atomic_load_n(&queue.head, __ATOMIC_ACQUIRE);
+  uint32_t tail = __atomic_load_n(&queue.tail, __ATOMIC_ACQUIRE);
+
+  fprintf(out, "Launch queue: depth %u/%u (max %u), pushed %llu, merged %llu, dropped %llu\n",
+          head - tail, LAUNCH_QUEUE_SIZE, __atomic_load_n(&queue.max_depth, __ATOMIC_RELAXED),
+          (unsigned long long)__atomic_load_n(&queue.pushed, __ATOMIC_RELAXED),
+          (unsigned long long)__atomic_load_n(&queue.merged, __ATOMIC_RELAXED),
+          (unsigned long long)__atomic_load_n(&queue.dropped, __ATOMIC_RELAXED));
+  if (spawn_pidfds) {
+    fprintf(out, "Children: %d running (max %d)\n", __atomic_load_n(&children_running, __ATOMIC_RELAXED),
+            __atomic_load_n(&children_max, __ATOMIC_RELAXED));
+  }
+  fflush(out);
+}
@@ -0,0 +1,301 @@
+/**************************************************************************
+*
+* fittsmon : map mouse button events on screen corners to commands.
+*             Window-less zones: XInput2 raw motion and a spatial grid.
+*
+* Copyright (C) 2009 Yasen Atanasov (yasen.atanasov@gmail.com)
+* Modified 2025 by Eric Bakker (linuxbirdtweets@duck.com)
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License version 2
+* as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**************************************************************************/
+
+/*
+ * With --windowless no zone windows are created. Raw motion events on the
+ * root window say the pointer moved; a QueryPointer then says where to,
+ * and a grid over the zones says which zone that is. At most one query is
+ * in flight: motion that arrives while one is pending asks for one more
+ * when it returns, so a fast-moving pointer costs a query per round trip
+ * rather than one per event.
+ *
+ * Entering a zone dispatches Enter and takes a passive grab of every
+ * button on the root window; leaving it dispatches Leave and releases the
+ * grab. Clicks are only taken from whatever is underneath while the
+ * pointer is inside a zone.
+ */
+
+
+/* INCLUDES */
+
+#include "fittsmon.h"
+
+#include <xcb/xcbext.h>
+#include <xcb/xinput.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+
+/* CONSTANTS/OPTIONS */
+
+/* Grid cells are 2^GRID_SHIFT pixels square */
+#define GRID_SHIFT 6
+
+/* GLOBALS */
+
+static xcb_connection_t *pointer_connection = NULL;
+static xcb_window_t pointer_root;
+static uint8_t xinput_opcode;
+
+/* Zones by grid cell: the zones overlapping cell c are
+   cell_zones[cell_start[c] .. cell_start[c + 1]) */
+static int grid_cols = 0;
+static int grid_rows = 0;
+static int *cell_start = NULL;
+static int *cell_zones = NULL;
+
+static int current_zone = -1;
+static char query_pending = 0;
+static char motion_pending = 0;
+static xcb_query_pointer_cookie_t query_cookie;
+static xcb_timestamp_t motion_time;  /* X time of the motion being resolved */
+
+/* implementations */
+
+static int
+zone_contains (int zone, int x, int y)
+{
+  const struct str_window_options *o = &window_options[zone];
+
+  return x >= o->x && x < o->x + o->w && y >= o->y && y < o->y + o->h;
+}
+
+/* The zone at a root window position, -1 if none. Where zones overlap
+   the later one wins, as its window would be stacked above. */
+int
+pointer_zone_at (int x, int y)
+{
+  int col = x >> GRID_SHIFT, row = y >> GRID_SHIFT, cell;
+
+  if (x < 0 || y < 0 || col >= grid_cols || row >= grid_rows) return -1;
+
+  cell = row * grid_cols + col;
+  for (int i = cell_start[cell + 1] - 1; i >= cell_start[cell]; i--) {
+    if (zone_contains(cell_zones[i], x, y)) return cell_zones[i];
+  }
+  return -1;
+}
+
+/* Build the grid from the enabled zones: count the zones per cell, then
+   fill them in. Returns 0 on success. */
+static int
+grid_build (void)
+{
+  int total = zones_per_monitor * monitor_count;
+  int cols = 0, rows = 0, entries = 0;
+  int *start, *zones;
+  int z, r, c;
+
+  for (z = 0; z < total; z++) {
+    const struct str_window_options *o = &window_options[z];
+
+    unless (o->enabled && o->w > 0 && o->h > 0) continue;
+    if (((o->x + o->w - 1) >> GRID_SHIFT) + 1 > cols) cols = ((o->x + o->w - 1) >> GRID_SHIFT) + 1;
+    if (((o->y + o->h - 1) >> GRID_SHIFT) + 1 > rows) rows = ((o->y + o->h - 1) >> GRID_SHIFT) + 1;
+  }
+
+  start = calloc((size_t)cols * rows + 1, sizeof(int));
+  unless (start) return -1;
+
+  for (z = 0; z < total; z++) {
+    const struct str_window_options *o = &window_options[z];
+
+    unless (o->enabled && o->w > 0 && o->h > 0) continue;
+    for (r = (o->y < 0 ? 0 : o->y) >> GRID_SHIFT; r <= (o->y + o->h - 1) >> GRID_SHIFT; r++) {
+      for (c = (o->x < 0 ? 0 : o->x) >> GRID_SHIFT; c <= (o->x + o->w - 1) >> GRID_SHIFT; c++) {
+        start[r * cols + c + 1]++;
+        entries++;
+      }
+    }
+  }
+  for (c = 0; c < cols * rows; c++) start[c + 1] += start[c];
+
+  zones = malloc((entries ? entries : 1) * sizeof(int));
+  unless (zones) {
+    free(start);
+    return -1;
+  }
+
+  /* Fill each cell from its end: start[c + 1] ends up at the start of
+     cell c, and zones within a cell stay in order */
+  for (z = total - 1; z >= 0; z--) {
+    const struct str_window_options *o = &window_options[z];
+
+    unless (o->enabled && o->w > 0 && o->h > 0) continue;
+    for (r = (o->y < 0 ? 0 : o->y) >> GRID_SHIFT; r <= (o->y + o->h - 1) >> GRID_SHIFT; r++) {
+      for (c = (o->x < 0 ? 0 : o->x) >> GRID_SHIFT; c <= (o->x + o->w - 1) >> GRID_SHIFT; c++) {
+        zones[--start[r * cols + c + 1]] = z;
+      }
+    }
+  }
+  memmove(start, start + 1, (size_t)cols * rows * sizeof(int));
+  start[cols * rows] = entries;
+
+  free(cell_start);
+  free(cell_zones);
+  cell_start = start;
+  cell_zones = zones;
+  grid_cols = cols;
+  grid_rows = rows;
+  return 0;
+}
+
+static void
+pointer_query (void)
+{
+  query_cookie = xcb_query_pointer(pointer_connection, pointer_root);
+  query_pending = 1;
+  motion_pending = 0;
+}
+
+/* Move from the current zone to another one, or to none (-1) */
+static void
+pointer_enter (int zone, xcb_timestamp_t time)
+{
+  if (zone == current_zone) return;
+
+  if (current_zone >= 0) {
+    xcb_ungrab_button(pointer_connection, XCB_BUTTON_INDEX_ANY, pointer_root, XCB_MOD_MASK_ANY);
+    if (window_options[current_zone].enabled) {
+      record_event(XCB_LEAVE_NOTIFY, 0, 0, current_zone, time);
+      dispatch_event(current_zone, Leave, 0, time);
+    }
+  }
+
+  current_zone = zone;
+
+  if (zone >= 0) {
+    xcb_grab_button(pointer_connection, 0, pointer_root, XCB_EVENT_MASK_BUTTON_PRESS,
+                    XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC, XCB_NONE, XCB_NONE,
+                    XCB_BUTTON_INDEX_ANY, XCB_MOD_MASK_ANY);
+    record_event(XCB_ENTER_NOTIFY, 0, 0, zone, time);
+    dispatch_event(zone, Enter, 0, time);
+  }
+}
+
+/* The zones moved, appeared or went away */
+void
+pointer_zones_changed (void)
+{
+  if (grid_build() < 0) {
+    fprintf(stderr, "Warning: Out of memory for the zone grid\n");
+    return;
+  }
+
+  unless (pointer_connection) return;
+
+  /* The zone the pointer was in may be gone: find out where it is now */
+  if (current_zone >= 0 && !window_options[current_zone].enabled) pointer_enter(-1, XCB_CURRENT_TIME);
+  if (query_pending) motion_pending = 1;
+  else pointer_query();
+}
+
+/* The zones were renumbered: whatever zone the pointer was in is gone,
+   without a Leave */
+void
+pointer_forget (void)
+{
+  unless (pointer_connection && current_zone >= 0) return;
+
+  xcb_ungrab_button(pointer_connection, XCB_BUTTON_INDEX_ANY, pointer_root, XCB_MOD_MASK_ANY);
+  current_zone = -1;
+}
+
+/* Select raw motion on the root window. Returns 0 on success, -1 if the
+   server has no XInput 2.2, in which case zones need their windows. */
+int
+pointer_start (xcb_connection_t *connection, xcb_screen_t *screen)
+{
+  const xcb_query_extension_reply_t *extension = xcb_get_extension_data(connection, &xcb_input_id);
+  xcb_input_xi_query_version_reply_t *version;
+  struct {
+    xcb_input_event_mask_t head;
+    xcb_input_xi_event_mask_t mask;
+  } mask;
+
+  unless (extension && extension->present) return -1;
+
+  version = xcb_input_xi_query_version_reply(connection, xcb_input_xi_query_version(connection, 2, 2), NULL);
+  unless (version && (version->major_version > 2 ||
+                      (version->major_version == 2 && version->minor_version >= 2))) {
+    free(version);
+    return -1;
+  }
+  free(version);
+
+  pointer_connection = connection;
+  pointer_root = screen->root;
+  xinput_opcode = extension->major_opcode;
+
+  mask.head.deviceid = XCB_INPUT_DEVICE_ALL_MASTER;
+  mask.head.mask_len = sizeof(mask.mask) / sizeof(uint32_t);
+  mask.mask = XCB_INPUT_XI_EVENT_MASK_RAW_MOTION;
+  xcb_input_xi_select_events(connection, pointer_root, 1, &mask.head);
+
+  pointer_zones_changed();
+  printf("Window-less mode: tracking the pointer with XInput2 raw motion\n");
+  return 0;
+}
+
+/* Is this one of the raw motion events we selected */
+int
+pointer_is_motion (const xcb_generic_event_t *event)
+{
+  const xcb_ge_generic_event_t *generic = (const xcb_ge_generic_event_t *)event;
+
+  return pointer_connection && (event->response_type & ~0x80) == XCB_GE_GENERIC &&
+         generic->extension == xinput_opcode && generic->event_type == XCB_INPUT_RAW_MOTION;
+}
+
+/* Take a raw motion event. Returns 1 if the event was one. */
+int
+pointer_handle_event (xcb_generic_event_t *event)
+{
+  unless (pointer_is_motion(event)) return 0;
+
+  motion_time = ((xcb_input_raw_motion_event_t *)event)->time;
+  if (query_pending) motion_pending = 1;
+  else pointer_query();
+  return 1;
+}
+
+/* Pick up the answer to the pending query, if it is in. Called after the
+   event queue is drained. */
+void
+pointer_poll (void)
+{
+  xcb_query_pointer_reply_t *reply = NULL;
+  xcb_generic_error_t *error = NULL;
+  int zone = -1;
+
+  unless (query_pending) return;
+  unless (xcb_poll_for_reply(pointer_connection, query_cookie.sequence, (void **)&reply, &error)) return;
+
+  query_pending = 0;
+  if (reply && reply->same_screen) zone = pointer_zone_at(reply->root_x, reply->root_y);
+  free(reply);
+  free(error);
+
+  pointer_enter(zone, motion_time);
+
+  if (motion_pending) pointer_query();
+}
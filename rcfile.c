@@ -0,0 +1,320 @@
+/**************************************************************************
+*
+* fittsmon : map mouse button events on screen corners to commands.
+*             fittsmonrc reader: sections and keys of a mapped file.
+*
+* Copyright (C) 2009 Yasen Atanasov (yasen.atanasov@gmail.com)
+* Modified 2025 by Eric Bakker (linuxbirdtweets@duck.com)
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License version 2
+* as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**************************************************************************/
+
+/*
+ * fittsmonrc is mapped copy-on-write and split in one pass. Section names,
+ * keys and values are cut out of the mapping by writing a NUL after each,
+ * so they need no copies. The entries are then grouped by section. That
+ * costs three allocations whatever the size of the file, and a lookup only
+ * looks through its own section.
+ *
+ * The syntax is the key file syntax fittsmonrc has always used: [Section]
+ * headers, Key=value lines and # comments. Blanks around keys and values
+ * are ignored, and a section given twice is merged. When a key is given
+ * twice in a section, the last one counts. Every problem is reported with
+ * its line number.
+ */
+
+
+/* INCLUDES */
+
+#include "fittsmon.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/* implementations */
+
+/* Map the file, or read it when its last line has no newline and it ends
+   on a page boundary: the NUL after that line needs a byte past the end */
+static int
+rc_load (struct str_rcfile *rc)
+{
+  struct stat st;
+  int fd = open(rc->path, O_RDONLY | O_CLOEXEC);
+
+  if (fd < 0 || fstat(fd, &st) < 0) {
+    fprintf(stderr, "%s: %s\n", rc->path, strerror(errno));
+    if (fd >= 0) close(fd);
+    return -1;
+  }
+  rc->size = st.st_size;
+
+  if (rc->size > 0) {
+    rc->data = mmap(NULL, rc->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (rc->data == MAP_FAILED) {
+      fprintf(stderr, "%s: %s\n", rc->path, strerror(errno));
+      rc->data = NULL;
+      close(fd);
+      return -1;
+    }
+    rc->mapped = 1;
+  }
+
+  if (rc->size == 0 || (rc->size % sysconf(_SC_PAGESIZE) == 0 && rc->data[rc->size - 1] != '\n')) {
+    char *data = malloc(rc->size + 1);
+
+    if (data && rc->size) memcpy(data, rc->data, rc->size);
+    if (rc->mapped) munmap(rc->data, rc->size);
+    rc->mapped = 0;
+    rc->data = data;
+    unless (data) {
+      fprintf(stderr, "%s: %s\n", rc->path, strerror(ENOMEM));
+      close(fd);
+      return -1;
+    }
+  }
+  close(fd);
+  return 0;
+}
+
+/* Index of a section, -1 if the file has none of that name */
+int
+rc_group (const struct str_rcfile *rc, const char *name)
+{
+  for (int g = 0; g < rc->group_count; g++) {
+    if (strcmp(rc->groups[g].name, name) == 0) return g;
+  }
+  return -1;
+}
+
+/* Read and split path. known_key says whether a key is one fittsmon
+   knows; others are warned about. Returns -1, with rc closed, if the file
+   cannot be read; syntax errors are counted in rc->errors. */
+int
+rc_open (struct str_rcfile *rc, const char *path, int (*known_key)(const char *key, size_t len))
+{
+  struct str_rc_entry *lines;
+  char *p, *end;
+  int line_count = 1, line_no = 0, group = -1, g, i;
+
+  memset(rc, 0, sizeof(*rc));
+  rc->path = path;
+  if (rc_load(rc) < 0) return -1;
+
+  end = rc->data + rc->size;
+  for (p = rc->data; (p = memchr(p, '\n', end - p)); p++) line_count++;
+
+  /* At most one section or entry per line */
+  lines = malloc(line_count * sizeof(struct str_rc_entry));
+  rc->groups = malloc(line_count * sizeof(struct str_rc_group));
+  unless (lines && rc->groups) {
+    free(lines);
+    rc_close(rc);
+    fprintf(stderr, "%s: %s\n", path, strerror(ENOMEM));
+    return -1;
+  }
+
+  for (p = rc->data; p < end; ) {
+    char *eol = memchr(p, '\n', end - p);
+    char *s = p, *e, *eq, *key_end;
+
+    unless (eol) eol = end;
+    e = eol;
+    line_no++;
+    p = eol + 1;
+
+    while (s < e && (*s == ' ' || *s == '\t')) s++;
+    while (e > s && (e[-1] == ' ' || e[-1] == '\t' || e[-1] == '\r')) e--;
+
+    if (s == e || *s == '#') continue;
+
+    if (*s == '[') {
+      if (e[-1] != ']' || e - s < 3) {
+        fprintf(stderr, "%s:%d: error: malformed section header\n", path, line_no);
+        rc->errors++;
+        continue;
+      }
+      e[-1] = '\0';
+      if ((group = rc_group(rc, s + 1)) < 0) {
+        group = rc->group_count++;
+        rc->groups[group].name = s + 1;
+        rc->groups[group].line = line_no;
+        rc->groups[group].count = 0;
+      }
+      continue;
+    }
+
+    unless ((eq = memchr(s, '=', e - s))) {
+      fprintf(stderr, "%s:%d: error: expected Key=value\n", path, line_no);
+      rc->errors++;
+      continue;
+    }
+    if (eq == s) {
+      fprintf(stderr, "%s:%d: error: missing key before '='\n", path, line_no);
+      rc->errors++;
+      continue;
+    }
+    if (group < 0) {
+      fprintf(stderr, "%s:%d: error: key outside of any [section]\n", path, line_no);
+      rc->errors++;
+      continue;
+    }
+
+    for (key_end = eq; key_end > s && (key_end[-1] == ' ' || key_end[-1] == '\t'); key_end--)
+      ;
+    unless (known_key(s, key_end - s)) {
+      fprintf(stderr, "%s:%d: warning: unknown key '%.*s'\n", path, line_no, (int)(key_end - s), s);
+    }
+    *key_end = '\0';
+    for (eq++; eq < e && (*eq == ' ' || *eq == '\t'); eq++)
+      ;
+    *e = '\0';
+
+    lines[rc->entry_count].key = s;
+    lines[rc->entry_count].value = eq;
+    lines[rc->entry_count].line = line_no;
+    lines[rc->entry_count].group = group;
+    lines[rc->entry_count].reported = 0;
+    rc->entry_count++;
+    rc->groups[group].count++;
+  }
+
+  /* Entries by section, in file order within each */
+  rc->entries = malloc((rc->entry_count ? rc->entry_count : 1) * sizeof(struct str_rc_entry));
+  unless (rc->entries) {
+    free(lines);
+    rc_close(rc);
+    fprintf(stderr, "%s: %s\n", path, strerror(ENOMEM));
+    return -1;
+  }
+  for (g = 0, i = 0; g < rc->group_count; g++) {
+    rc->groups[g].first = i;
+    i += rc->groups[g].count;
+    rc->groups[g].count = 0;
+  }
+  for (i = 0; i < rc->entry_count; i++) {
+    struct str_rc_group *owner = &rc->groups[lines[i].group];
+
+    rc->entries[owner->first + owner->count++] = lines[i];
+  }
+  free(lines);
+
+  return 0;
+}
+
+void
+rc_close (struct str_rcfile *rc)
+{
+  if (rc->mapped) munmap(rc->data, rc->size);
+  else free(rc->data);
+  free(rc->groups);
+  free(rc->entries);
+  memset(rc, 0, sizeof(*rc));
+}
+
+/* The entry for key, or key.option when option is not NULL, in a
+   section. NULL if it is not set. */
+const struct str_rc_entry *
+rc_lookup (const struct str_rcfile *rc, int group, const char *key, const char *option)
+{
+  size_t len = strlen(key);
+
+  if (group < 0) return NULL;
+
+  for (int i = rc->groups[group].first + rc->groups[group].count - 1; i >= rc->groups[group].first; i--) {
+    const char *name = rc->entries[i].key;
+
+    unless (strncmp(name, key, len) == 0) continue;
+    if (option ? name[len] == '.' && strcmp(name + len + 1, option) == 0 : name[len] == '\0') {
+      return &rc->entries[i];
+    }
+  }
+  return NULL;
+}
+
+/* Value of key in a section, NULL if it is not set */
+char *
+rc_value (const struct str_rcfile *rc, int group, const char *key)
+{
+  const struct str_rc_entry *entry = rc_lookup(rc, group, key, NULL);
+
+  return entry ? entry->value : NULL;
+}
+
+/* A value that does not parse. Entries read once per monitor are only
+   reported the first time. */
+void
+rc_bad_value (struct str_rcfile *rc, const struct str_rc_entry *entry, const char *expected)
+{
+  struct str_rc_entry *bad = &rc->entries[entry - rc->entries];
+
+  unless (bad->reported) fprintf(stderr, "%s:%d: error: %s: expected %s\n", rc->path, bad->line, bad->key, expected);
+  bad->reported = 1;
+  rc->errors++;
+}
+
+/* A true/false (or 1/0) key, 0 when it is not set */
+int
+rc_boolean (struct str_rcfile *rc, int group, const char *key, const char *option)
+{
+  const struct str_rc_entry *entry = rc_lookup(rc, group, key, option);
+
+  unless (entry) return 0;
+  if (strcmp(entry->value, "true") == 0 || strcmp(entry->value, "1") == 0) return 1;
+  if (strcmp(entry->value, "false") == 0 || strcmp(entry->value, "0") == 0) return 0;
+
+  rc_bad_value(rc, entry, "true or false");
+  return 0;
+}
+
+/* A numeric key, fallback when it is not set */
+double
+rc_number (struct str_rcfile *rc, int group, const char *key, const char *option, double fallback)
+{
+  const struct str_rc_entry *entry = rc_lookup(rc, group, key, option);
+  char *end;
+  double value;
+
+  unless (entry) return fallback;
+
+  value = strtod(entry->value, &end);
+  if (end == entry->value || *end) {
+    rc_bad_value(rc, entry, "a number");
+    return fallback;
+  }
+  return value;
+}
+
+/* Next item of a ;-separated list, cut out in place with the blanks
+   around it removed. Returns NULL at the end of the list. */
+char *
+rc_list_next (char **cursor)
+{
+  char *item = *cursor, *end;
+
+  unless (item && *item) return NULL;
+
+  end = strchr(item, ';');
+  *cursor = end ? end + 1 : item + strlen(item);
+  unless (end) end = item + strlen(item);
+
+  while (item < end && (*item == ' ' || *item == '\t')) item++;
+  while (end > item && (end[-1] == ' ' || end[-1] == '\t')) end--;
+  *end = '\0';
+  return item;
+}
@@ -0,0 +1,350 @@
+/**************************************************************************
+*
+* fittsmon : map mouse button events on screen corners to commands.
+*             Recording zone events and replaying them without X.
+*
+* Copyright (C) 2009 Yasen Atanasov (yasen.atanasov@gmail.com)
+* Modified 2025 by Eric Bakker (linuxbirdtweets@duck.com)
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License version 2
+* as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**************************************************************************/
+
+/*
+ * --record FILE writes every button press, Enter and Leave the event loop
+ * resolves to a zone as a 16-byte record: X event type, button or notify
+ * detail, modifier state, zone, X timestamp and the time since the
+ * previous record. A header in front holds the monitors and the zones per
+ * monitor, as they were when recording started. Records are buffered and
+ * written once per batch of X events, before the event loop sleeps.
+ * Zones are numbered by that layout, so a monitor connecting or going
+ * away, or fittsmonrc changing the zones per monitor, ends the recording.
+ *
+ * --replay FILE needs no X server. The recorded monitors get their zones
+ * from fittsmonrc as usual, each zone a stand-in window id, and every
+ * record goes back through server_handle_event as the X event it was: the
+ * window lookup, throttling and dispatch run as they do live. Commands are
+ * not started (see spawn_dry_run). Records are fed at their recorded pace,
+ * or back to back with --fast, where Coalesce and Dwell waits only end
+ * between records once their time has come by the clock, so a Leave
+ * recorded well after an Enter may still cancel a Dwell. Whatever is
+ * still waiting when the recording ends is launched.
+ *
+ * The file is in the byte order of the machine that wrote it.
+ */
+
+
+/* INCLUDES */
+
+#include "fittsmon.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+
+/* CONSTANTS/OPTIONS */
+
+#define RECORD_MAGIC "FITTSREC"
+#define RECORD_VERSION 1
+
+/* More monitors than this is a damaged header */
+#define RECORD_MAX_MONITORS 1024
+
+/* Records buffered before a write */
+#define RECORD_BUFFER 256
+
+/* STRUCTS */
+
+struct str_record_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t zones_per_monitor;
+  uint32_t monitor_count;
+  uint32_t reserved;
+};
+
+struct str_record_monitor {
+  char name[64];
+  int32_t x, y, width, height;
+  uint8_t primary, enabled, connected, reserved;
+};
+
+struct str_record {
+  uint32_t delay_us;  /* since the previous record */
+  uint32_t time;      /* X server timestamp */
+  uint16_t zone;
+  uint16_t state;
+  uint8_t type;       /* XCB_BUTTON_PRESS, XCB_ENTER_NOTIFY or XCB_LEAVE_NOTIFY */
+  uint8_t detail;
+  uint8_t reserved[2];
+};
+
+/* GLOBALS */
+
+static int record_fd = -1;
+static struct str_record buffer[RECORD_BUFFER];
+static int buffered = 0;
+static long long last_ns = 0;
+
+/* The file --replay reads, and its zones per monitor */
+static FILE *replay_file = NULL;
+static uint32_t replay_zones = 0;
+
+/* implementations */
+
+/* Create the recording and write its header. Returns -1 on failure. */
+int
+record_start (const char *path)
+{
+  struct str_record_header header;
+  struct str_record_monitor monitor;
+
+  record_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (record_fd < 0) {
+    fprintf(stderr, "Cannot record to %s: %s\n", path, strerror(errno));
+    return -1;
+  }
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, RECORD_MAGIC, sizeof(header.magic));
+  header.version = RECORD_VERSION;
+  header.zones_per_monitor = zones_per_monitor;
+  header.monitor_count = monitor_count;
+
+  int ok = write(record_fd, &header, sizeof(header)) == sizeof(header);
+
+  for (int i = 0; ok && i < monitor_count; i++) {
+    memset(&monitor, 0, sizeof(monitor));
+    memcpy(monitor.name, monitors[i].name, sizeof(monitor.name));
+    monitor.x = monitors[i].x;
+    monitor.y = monitors[i].y;
+    monitor.width = monitors[i].width;
+    monitor.height = monitors[i].height;
+    monitor.primary = monitors[i].primary ? 1 : 0;
+    monitor.enabled = monitors[i].enabled ? 1 : 0;
+    monitor.connected = monitors[i].connected ? 1 : 0;
+    ok = write(record_fd, &monitor, sizeof(monitor)) == sizeof(monitor);
+  }
+
+  unless (ok) {
+    fprintf(stderr, "Cannot record to %s: %s\n", path, strerror(errno));
+    close(record_fd);
+    record_fd = -1;
+    return -1;
+  }
+
+  last_ns = stats_now_ns();
+  printf("Recording zone events to %s\n", path);
+  return 0;
+}
+
+/* Write the buffered records. A failed write ends the recording. */
+void
+record_flush (void)
+{
+  size_t size = buffered * sizeof(struct str_record);
+
+  unless (buffered) return;
+  buffered = 0;
+
+  if (write(record_fd, buffer, size) != (ssize_t)size) {
+    fprintf(stderr, "Warning: Recording stopped: %s\n", strerror(errno));
+    close(record_fd);
+    record_fd = -1;
+  }
+}
+
+/* End the recording, keeping what was recorded so far */
+void
+record_stop (const char *reason)
+{
+  if (record_fd < 0) return;
+
+  record_flush();
+  if (record_fd < 0) return;
+  close(record_fd);
+  record_fd = -1;
+  fprintf(stderr, "Warning: Recording stopped: %s\n", reason);
+}
+
+/* Log an X event resolved to a zone */
+void
+record_event (int type, int detail, int state, int zone, xcb_timestamp_t time)
+{
+  struct str_record *record;
+  long long now, delay;
+
+  if (record_fd < 0) return;
+
+  now = stats_now_ns();
+  delay = (now - last_ns) / 1000;
+  last_ns = now;
+
+  record = &buffer[buffered++];
+  record->delay_us = delay > UINT32_MAX ? UINT32_MAX : (uint32_t)delay;
+  record->time = time;
+  record->zone = zone;
+  record->state = state;
+  record->type = type;
+  record->detail = detail;
+  record->reserved[0] = record->reserved[1] = 0;
+
+  if (buffered == RECORD_BUFFER) record_flush();
+}
+
+/* Open a recording and set up its monitors, all on one stand-in display.
+   Returns -1 if it cannot be read. */
+int
+replay_open (const char *path)
+{
+  struct str_record_header header;
+  struct str_record_monitor monitor;
+
+  unless ((replay_file = fopen(path, "rb"))) {
+    fprintf(stderr, "Cannot replay %s: %s\n", path, strerror(errno));
+    return -1;
+  }
+  if (fread(&header, sizeof(header), 1, replay_file) != 1 ||
+      memcmp(header.magic, RECORD_MAGIC, sizeof(header.magic)) != 0 || header.version != RECORD_VERSION ||
+      header.monitor_count > RECORD_MAX_MONITORS) {
+    fprintf(stderr, "Error: %s is not a fittsmon recording\n", path);
+    return -1;
+  }
+  replay_zones = header.zones_per_monitor;
+
+  unless ((displays = calloc(1, sizeof(struct str_display))) && monitors_reserve(header.monitor_count)) {
+    fprintf(stderr, "Out of memory\n");
+    return -1;
+  }
+  display_count = 1;
+  displays[0].fd = -1;
+  displays[0].randr_event_base = -1;
+
+  for (uint32_t i = 0; i < header.monitor_count; i++) {
+    if (fread(&monitor, sizeof(monitor), 1, replay_file) != 1) {
+      fprintf(stderr, "Error: %s is cut short\n", path);
+      return -1;
+    }
+    memcpy(monitors[i].name, monitor.name, sizeof(monitors[i].name));
+    monitors[i].name[sizeof(monitors[i].name) - 1] = '\0';
+    monitors[i].x = monitor.x;
+    monitors[i].y = monitor.y;
+    monitors[i].width = monitor.width;
+    monitors[i].height = monitor.height;
+    monitors[i].primary = monitor.primary;
+    monitors[i].enabled = monitor.enabled;
+    monitors[i].connected = monitor.connected;
+  }
+  monitor_count = header.monitor_count;
+  return 0;
+}
+
+/* Sleep until due, CLOCK_MONOTONIC ns, launching coalesced bursts and
+   dwelling events whose time comes meanwhile */
+static void
+replay_wait (long long due, int dwell_fd)
+{
+  struct pollfd pfd = { .fd = dwell_fd, .events = POLLIN };
+  long long now;
+
+  while ((now = stats_now_ns()) < due) {
+    int timeout = (int)((due - now + 999999) / 1000000);
+    int burst = dispatch_timeout();
+
+    if (burst >= 0 && burst < timeout) timeout = burst;
+    if (poll(&pfd, dwell_fd >= 0, timeout) > 0) dwell_handle(dwell_fd, POLLIN);
+    dispatch_expire();
+  }
+}
+
+/* Hand one record to the event path as the X event it came from */
+static void
+replay_event (const struct str_record *record)
+{
+  union {
+    xcb_generic_event_t generic;
+    xcb_button_press_event_t button;
+    xcb_enter_notify_event_t crossing;
+  } event;
+  xcb_window_t window = window_options[record->zone].xcb_window;
+
+  memset(&event, 0, sizeof(event));
+  event.generic.response_type = record->type;
+
+  if (record->type == XCB_BUTTON_PRESS) {
+    event.button.detail = record->detail;
+    event.button.time = record->time;
+    event.button.event = window;
+    event.button.state = record->state;
+  } else {
+    event.crossing.detail = record->detail;
+    event.crossing.time = record->time;
+    event.crossing.event = window;
+    event.crossing.state = record->state;
+  }
+
+  server_handle_event(displays[0].connection, &event.generic);
+}
+
+/* Feed the opened recording through the event path, then report its
+   throughput. Returns 0 when every record was replayed. */
+int
+replay_run (int fast)
+{
+  struct str_record record;
+  long long started = stats_now_ns(), due = started, elapsed;
+  unsigned long long count = 0, skipped = 0;
+  int dwell_fd = dwell_init();
+
+  if (replay_zones != (uint32_t)zones_per_monitor) {
+    fprintf(stderr, "Error: The recording has %u zones per monitor, fittsmonrc %d\n", replay_zones,
+            zones_per_monitor);
+    return -1;
+  }
+
+  while (fread(&record, sizeof(record), 1, replay_file) == 1) {
+    unless (record.zone < zones_per_monitor * monitor_count &&
+            (record.type == XCB_BUTTON_PRESS || record.type == XCB_ENTER_NOTIFY ||
+             record.type == XCB_LEAVE_NOTIFY)) {
+      skipped++;
+      continue;
+    }
+
+    if (fast) {
+      dwell_expire(0);
+      dispatch_expire();
+    } else {
+      due += (long long)record.delay_us * 1000;
+      replay_wait(due, dwell_fd);
+    }
+    replay_event(&record);
+    /* Ahead of the trace rings filling up */
+    if (++count % RECORD_BUFFER == 0) trace_flush();
+  }
+  /* The pointer stays where the recording left it */
+  dwell_expire(1);
+  dispatch_flush();
+
+  elapsed = stats_now_ns() - started;
+  printf("Replayed %llu events in %.3f s, %.0f events/s\n", count, elapsed / 1e9,
+         elapsed > 0 ? count * 1e9 / elapsed : 0.0);
+  if (skipped) fprintf(stderr, "Warning: Skipped %llu records of zones or events not known\n", skipped);
+
+  fclose(replay_file);
+  replay_file = NULL;
+  return 0;
+}
@@ -0,0 +1,395 @@
+/**************************************************************************
+*
+* fittsmon : map mouse button events on screen corners to commands.
+*             Command tokenizing and shell-free process spawning.
+*
+* Copyright (C) 2009 Yasen Atanasov (yasen.atanasov@gmail.com)
+* Modified 2025 by Eric Bakker (linuxbirdtweets@duck.com)
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License version 2
+* as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**************************************************************************/
+
+
+/* INCLUDES */
+
+#include "fittsmon.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+#ifndef P_PIDFD
+#define P_PIDFD 3
+#endif
+
+/* GLOBALS */
+
+/* Set when children can be waited for through a pidfd (Linux 5.4). The
+   launcher then reaps the commands it started itself, and SIGCHLD only
+   reaps helpers. */
+int spawn_pidfds = 0;
+
+/* --replay: commands are prepared as for a launch but not started */
+int spawn_dry_run = 0;
+
+static posix_spawnattr_t spawn_attr;
+
+/* implementations */
+
+/* Reap exited children; commands are never waited for synchronously.
+   SIGCHLD is blocked and read from the event loop's signalfd, which calls
+   this. With pidfds the launcher's children are its own to reap, so only
+   the helpers are waited for here, each by its pid, and the children the
+   launcher has no pidfd for when it runs without its thread. */
+void
+spawn_reap (void)
+{
+  pid_t pid;
+
+  if (spawn_pidfds) {
+    helpers_reap();
+    launcher_reap_untracked();
+    return;
+  }
+
+  while ((pid = waitpid(-1, NULL, WNOHANG)) > 0) {
+    stats_exited(pid);
+    helper_exited(pid);
+  }
+}
+
+/* A pidfd for a child, close-on-exec. Returns -1 on failure. */
+int
+spawn_pidfd (pid_t pid)
+{
+  return syscall(SYS_pidfd_open, pid, 0);
+}
+
+void
+spawn_init (void)
+{
+  siginfo_t info;
+  sigset_t mask;
+  int fd;
+
+  /* A helper that went away shows up as EPIPE on its pipe instead */
+  signal(SIGPIPE, SIG_IGN);
+
+  /* Children start with an empty signal mask and default dispositions,
+     the same environment system() used to give them: the signals the
+     event loop blocks for its signalfd are not blocked in them. */
+  posix_spawnattr_init(&spawn_attr);
+  sigemptyset(&mask);
+  posix_spawnattr_setsigmask(&spawn_attr, &mask);
+  sigaddset(&mask, SIGCHLD);
+  sigaddset(&mask, SIGPIPE);
+  posix_spawnattr_setsigdefault(&spawn_attr, &mask);
+  posix_spawnattr_setflags(&spawn_attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+  /* Waiting on a pidfd of our own fails with ECHILD where waitid knows
+     P_PIDFD, EINVAL where it does not */
+  if ((fd = spawn_pidfd(getpid())) >= 0) {
+    spawn_pidfds = waitid(P_PIDFD, fd, &info, WEXITED | WNOHANG) < 0 && errno == ECHILD;
+    close(fd);
+  }
+}
+
+/* Expand the %n repeat-count placeholder in one word, appending the
+   result to buf. "%n*K" expands to count * K. Returns the expanded
+   word, or NULL if buf is full. */
+static char *
+command_expand_word (const char *word, unsigned int count, char **buf, char *buf_end)
+{
+  char *start = *buf;
+  char *out = *buf;
+
+  while (*word) {
+    unsigned long value = count;
+    int n;
+
+    if (word[0] != '%' || word[1] != 'n') {
+      if (out == buf_end) return NULL;
+      *out++ = *word++;
+      continue;
+    }
+
+    word += 2;
+    if (word[0] == '*' && word[1] >= '0' && word[1] <= '9') {
+      value *= strtoul(word + 1, (char **)&word, 10);
+    }
+
+    n = snprintf(out, buf_end - out, "%lu", value);
+    if (n < 0 || n >= buf_end - out) return NULL;
+    out += n;
+  }
+
+  if (out == buf_end) return NULL;
+  *out++ = '\0';
+  *buf = out;
+  return start;
+}
+
+/* Start a command without waiting for it. glibc implements posix_spawn
+   with vfork semantics, so this costs one clone and one exec. count is
+   the number of events the launch stands for, substituted for %n. envp
+   is the environment to start it in, NULL for fittsmon's own. Returns the
+   pid, 0 for a dry run, -1 on failure. */
+pid_t
+spawn_command (const struct str_command *command, unsigned int count, char *const envp[])
+{
+  char *const *argv = command->argv;
+  pid_t pid;
+  int err;
+
+  unless (argv) return -1;
+
+  if (command->counted) {
+    int argc = 0;
+
+    while (argv[argc]) argc++;
+
+    char *expanded[argc + 1];
+    char buf[4 * MAX_COMMAND_LEN];
+    char *out = buf;
+
+    for (int i = 0; i < argc; i++) {
+      unless ((expanded[i] = command_expand_word(argv[i], count, &out, buf + sizeof(buf)))) {
+        fprintf(stderr, "Command too long after expanding %%n: %s\n", command->line);
+        return -1;
+      }
+    }
+    expanded[argc] = NULL;
+
+    if (spawn_dry_run) return 0;
+    err = posix_spawnp(&pid, expanded[0], NULL, &spawn_attr, expanded, envp ? envp : environ);
+  } else {
+    if (spawn_dry_run) return 0;
+    err = posix_spawnp(&pid, argv[0], NULL, &spawn_attr, argv, envp ? envp : environ);
+  }
+
+  if (err != 0) {
+    fprintf(stderr, "Command failed to start (%s): %s\n", strerror(err), command->line);
+    return -1;
+  }
+
+  return pid;
+}
+
+/* Start a long-lived helper with a pipe to its stdin. The write end is
+   returned in *fd, non-blocking. Returns the pid, -1 on failure. */
+pid_t
+spawn_helper (const struct str_command *command, int *fd)
+{
+  posix_spawn_file_actions_t actions;
+  int pipe_fds[2];
+  pid_t pid;
+  int err;
+
+  unless (command->argv && !spawn_dry_run) return -1;
+
+  if (pipe2(pipe_fds, O_CLOEXEC) < 0) {
+    perror("pipe2");
+    return -1;
+  }
+
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, pipe_fds[0], STDIN_FILENO);
+  err = posix_spawnp(&pid, command->argv[0], &actions, &spawn_attr, command->argv, environ);
+  posix_spawn_file_actions_destroy(&actions);
+  close(pipe_fds[0]);
+
+  if (err != 0) {
+    fprintf(stderr, "Helper failed to start (%s): %s\n", strerror(err), command->line);
+    close(pipe_fds[1]);
+    return -1;
+  }
+
+  fcntl(pipe_fds[1], F_SETFL, O_NONBLOCK);
+  *fd = pipe_fds[1];
+  return pid;
+}
+
+/* Split a command line into an argv vector. Words are separated by blanks
+   and may be grouped with single or double quotes. The pointer table and
+   the words share a single allocation, released with free(). */
+static char **
+command_tokenize (const char *line, size_t len)
+{
+  size_t max_words = len / 2 + 2;
+  char **argv;
+  char *out;
+  const char *p = line;
+  const char *end = line + len;
+  int argc = 0;
+
+  argv = malloc(max_words * sizeof(char *) + len + 1);
+  unless (argv) return NULL;
+  out = (char *)(argv + max_words);
+
+  for (;;) {
+    char quote = 0;
+
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    if (p == end) break;
+
+    argv[argc++] = out;
+    while (p < end && (quote || (*p != ' ' && *p != '\t'))) {
+      if (quote) {
+        if (*p == quote) quote = 0;
+        else *out++ = *p;
+      } else if (*p == '"' || *p == '\'') {
+        quote = *p;
+      } else {
+        *out++ = *p;
+      }
+      p++;
+    }
+    *out++ = '\0';
+
+    if (quote) {
+      fprintf(stderr, "Warning: Unbalanced quote in command: %s\n", line);
+      free(argv);
+      return NULL;
+    }
+  }
+
+  if (argc == 0) {
+    free(argv);
+    return NULL;
+  }
+
+  argv[argc] = NULL;
+  return argv;
+}
+
+/* argv for a command that opted in to the shell: /bin/sh -c "line" */
+static char **
+command_shell_argv (const char *line)
+{
+  static const char sh[] = "/bin/sh";
+  static const char opt[] = "-c";
+  size_t len = strlen(line);
+  char **argv;
+  char *out;
+
+  argv = malloc(4 * sizeof(char *) + sizeof(sh) + sizeof(opt) + len + 1);
+  unless (argv) return NULL;
+  out = (char *)(argv + 4);
+
+  argv[0] = memcpy(out, sh, sizeof(sh));
+  out += sizeof(sh);
+  argv[1] = memcpy(out, opt, sizeof(opt));
+  out += sizeof(opt);
+  argv[2] = memcpy(out, line, len + 1);
+  argv[3] = NULL;
+
+  return argv;
+}
+
+void
+command_clear (struct str_command *command)
+{
+  free(command->argv);
+  command->argv = NULL;
+  free(command->line);
+  command->line = NULL;
+  command->shell = 0;
+  command->counted = 0;
+  command->internal = ACTION_NONE;
+  command->coalesce_ms = 0;
+}
+
+/* Tokenize and validate a command line once, at config load time.
+   Returns 1 when the command can be spawned, 0 when it is left unbound. */
+int
+command_parse (struct str_command *command, const char *line, int shell)
+{
+  size_t len;
+
+  command_clear(command);
+  unless (line) return 0;
+
+  unless ((command->line = strdup(line))) return 0;
+  command->shell = shell ? 1 : 0;
+
+  if (strlen(line) >= MAX_COMMAND_LEN) {
+    fprintf(stderr, "Warning: Command too long (max %d bytes): %s\n", MAX_COMMAND_LEN - 1, line);
+    command->line[0] = '\0';
+    return 0;
+  }
+
+  /* Trim trailing blanks and a single trailing '&': every command is
+     started in the background, with or without it. */
+  len = strlen(command->line);
+  while (len > 0 && (command->line[len-1] == ' ' || command->line[len-1] == '\t')) len--;
+  if (len > 0 && command->line[len-1] == '&') {
+    len--;
+    while (len > 0 && (command->line[len-1] == ' ' || command->line[len-1] == '\t')) len--;
+  }
+  command->line[len] = '\0';
+
+  if (len == 0) return 0;
+
+  /* Built-in actions are run by fittsmon itself, nothing to tokenize */
+  if (command->line[0] == '@') {
+    unless ((command->internal = ewmh_action_parse(command->line))) {
+      fprintf(stderr, "Warning: Unknown built-in action: %s\n", command->line);
+    }
+    return command->internal != ACTION_NONE;
+  }
+
+  command->counted = strstr(command->line, "%n") != NULL;
+
+  if (command->shell) {
+    command->argv = command_shell_argv(command->line);
+    return command->argv != NULL;
+  }
+
+  command->argv = command_tokenize(command->line, len);
+  unless (command->argv) return 0;
+
+  unless (is_safe_command(command->argv)) {
+    fprintf(stderr, "Warning: Potentially dangerous command blocked (contains shell metacharacters, "
+            "set <Event>.Shell=true to run it through /bin/sh): %s\n", command->line);
+    free(command->argv);
+    command->argv = NULL;
+    return 0;
+  }
+
+  return 1;
+}
+
+/* Validate tokenized command for shell metacharacters. Commands are no
+   longer run by a shell, so these would reach the program literally
+   instead of doing what the user meant. */
+int
+is_safe_command (char *const argv[])
+{
+  const char *dangerous = ";|&><`$()\\";
+
+  if (!argv || !argv[0]) return 0;
+
+  for (int i = 0; argv[i]; i++) {
+    if (argv[i][strcspn(argv[i], dangerous)] != '\0') return 0;
+  }
+
+  return 1;
+}
@@ -0,0 +1,312 @@
+/**************************************************************************
+*
+* fittsmon : map mouse button events on screen corners to commands.
+*             Dispatch counters and latency histograms.
+*
+* Copyright (C) 2009 Yasen Atanasov (yasen.atanasov@gmail.com)
+* Modified 2025 by Eric Bakker (linuxbirdtweets@duck.com)
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License version 2
+* as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**************************************************************************/
+
+/*
+ * Three intervals are measured for every spawned command:
+ *
+ *   X event -> dequeue  X server timestamp to fittsmon reading the event
+ *   dequeue -> spawn    reading the event to calling posix_spawn
+ *   spawn   -> exit     calling posix_spawn to the child being reaped
+ *
+ * Samples go into histograms with one bucket per power of two
+ * nanoseconds. Recording is a handful of relaxed atomic adds into fixed
+ * arrays, with no lock and no allocation, because samples come from the
+ * X reader and the launcher thread alike.
+ *
+ * X server time is in milliseconds of CLOCK_MONOTONIC on Linux servers,
+ * so the first interval only has millisecond resolution, and is not
+ * recorded at all when the server clock is clearly a different one (a
+ * remote display).
+ *
+ * A child is matched to its spawn through a small table indexed by pid.
+ * Without pidfds the reaper in the event loop may get there before the
+ * launcher; the one that finds the other's mark records the sample.
+ */
+
+
+/* INCLUDES */
+
+#include "fittsmon.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+
+/* CONSTANTS/OPTIONS */
+
+/* Bucket b holds samples of [2^(b-1), 2^b) ns, the last one everything above */
+#define STATS_BUCKETS 40
+
+/* Children tracked at once, must be a power of two */
+#define STATS_CHILD_SLOTS 256
+
+#define CHILD_SPAWNED 1
+#define CHILD_EXITED  2
+#define child_state(pid,flag) ( ((uint64_t)(uint32_t)(pid) << 2) | (flag) )
+
+/* X server time further off than this is not our clock */
+#define STATS_XTIME_BEHIND_MS 60000
+#define STATS_XTIME_AHEAD_MS  1000
+
+/* STRUCTS */
+
+struct str_histogram {
+  uint64_t buckets[STATS_BUCKETS];
+  uint64_t count;
+  uint64_t sum_ns;
+  uint64_t max_ns;
+};
+
+struct str_child {
+  uint64_t state;     /* pid << 2 | CHILD_SPAWNED or CHILD_EXITED, 0 = free */
+  long long spawned;  /* written before the state that announces it */
+  long long exited;
+};
+
+/* GLOBALS */
+
+static const char *interval_names[STATS_INTERVALS] = {
+  "X event -> dequeue", "dequeue -> spawn", "spawn -> exit"
+};
+
+static const char *counter_names[STATS_COUNTERS] = {
+  "launched", "rate limited", "coalesced", "spawn failed", "dwell cancelled", "busy", "replaced"
+};
+
+static struct str_histogram histograms[STATS_INTERVALS];
+static uint64_t counters[STATS_COUNTERS][EVENT_COUNT];
+static uint64_t xtime_skewed = 0;
+static struct str_child children[STATS_CHILD_SLOTS];
+
+/* implementations */
+
+long long
+stats_now_ns (void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Add one sample to an interval's histogram. Async-signal-safe. */
+void
+stats_record (int interval, long long ns)
+{
+  struct str_histogram *histogram = &histograms[interval];
+  uint64_t value = ns > 0 ? (uint64_t)ns : 0;
+  uint64_t max = __atomic_load_n(&histogram->max_ns, __ATOMIC_RELAXED);
+  int bucket = value ? 64 - __builtin_clzll(value) : 0;
+
+  if (bucket >= STATS_BUCKETS) bucket = STATS_BUCKETS - 1;
+
+  __atomic_add_fetch(&histogram->buckets[bucket], 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&histogram->count, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&histogram->sum_ns, value, __ATOMIC_RELAXED);
+  while (value > max && !__atomic_compare_exchange_n(&histogram->max_ns, &max, value, 1,
+                                                     __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ;
+}
+
+void
+stats_count (int counter, int event, unsigned int n)
+{
+  __atomic_add_fetch(&counters[counter][event], n, __ATOMIC_RELAXED);
+}
+
+/* An event was read from the X connection at now (stats_now_ns) */
+void
+stats_dequeued (int win, int event, xcb_timestamp_t time, long long now)
+{
+  int32_t delay_ms = (int32_t)((uint32_t)(now / 1000000) - time);
+
+  window_options[win].counts[event]++;
+
+  /* Rounding can put the server a little ahead of us; that counts as 0 */
+  if (delay_ms < -STATS_XTIME_AHEAD_MS || delay_ms > STATS_XTIME_BEHIND_MS) {
+    __atomic_add_fetch(&xtime_skewed, 1, __ATOMIC_RELAXED);
+    return;
+  }
+  stats_record(STATS_X_TO_DEQUEUE, (long long)delay_ms * 1000000);
+}
+
+/* A command spawned at started, as pid, for an event dequeued at
+   dequeued. A failed spawn has pid -1. */
+void
+stats_spawned (pid_t pid, long long dequeued, long long started)
+{
+  struct str_child *child = &children[pid & (STATS_CHILD_SLOTS - 1)];
+  uint64_t state;
+
+  stats_record(STATS_DEQUEUE_TO_SPAWN, started - dequeued);
+  if (pid < 0) return;
+
+  state = __atomic_load_n(&child->state, __ATOMIC_ACQUIRE);
+  for (;;) {
+    if (state == child_state(pid, CHILD_EXITED)) {
+      /* It exited before we got here */
+      if (__atomic_compare_exchange_n(&child->state, &state, 0, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        stats_record(STATS_SPAWN_TO_EXIT, child->exited - started);
+        return;
+      }
+      continue;
+    }
+    /* Another child still running in this slot keeps it */
+    if (state & CHILD_SPAWNED) return;
+
+    child->spawned = started;
+    if (__atomic_compare_exchange_n(&child->state, &state, child_state(pid, CHILD_SPAWNED), 0,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      return;
+    }
+  }
+}
+
+/* pid was reaped. Runs on the X reader, racing the launcher's stats_spawned. */
+void
+stats_exited (pid_t pid)
+{
+  struct str_child *child = &children[pid & (STATS_CHILD_SLOTS - 1)];
+  long long now = stats_now_ns();
+  uint64_t state;
+
+  state = __atomic_load_n(&child->state, __ATOMIC_ACQUIRE);
+  for (;;) {
+    if (state == child_state(pid, CHILD_SPAWNED)) {
+      if (__atomic_compare_exchange_n(&child->state, &state, 0, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        stats_record(STATS_SPAWN_TO_EXIT, now - child->spawned);
+        return;
+      }
+      continue;
+    }
+    /* Another child still running in this slot keeps it. Otherwise leave
+       a mark in case the spawn has yet to be recorded; helpers' marks
+       are simply never claimed. */
+    if (state & CHILD_SPAWNED) return;
+
+    child->exited = now;
+    if (__atomic_compare_exchange_n(&child->state, &state, child_state(pid, CHILD_EXITED), 0,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      return;
+    }
+  }
+}
+
+/* Write a duration the way a person reads it */
+static void
+stats_print_duration (FILE *out, uint64_t ns)
+{
+  if (ns < 1000) fprintf(out, "%6llu ns", (unsigned long long)ns);
+  else if (ns < 1000000) fprintf(out, "%6.1f us", ns / 1e3);
+  else if (ns < 1000000000) fprintf(out, "%6.1f ms", ns / 1e6);
+  else fprintf(out, "%6.1f s ", ns / 1e9);
+}
+
+/* Upper bound of the bucket holding the given fraction of the samples */
+static uint64_t
+stats_percentile (const uint64_t *buckets, uint64_t count, double fraction)
+{
+  uint64_t wanted = (uint64_t)(count * fraction);
+  uint64_t seen = 0;
+
+  for (int b = 0; b < STATS_BUCKETS; b++) {
+    seen += buckets[b];
+    if (seen > wanted) return b ? (uint64_t)1 << b : 1;
+  }
+  return (uint64_t)1 << STATS_BUCKETS;
+}
+
+static void
+stats_print_histogram (FILE *out, int interval)
+{
+  struct str_histogram *histogram = &histograms[interval];
+  uint64_t buckets[STATS_BUCKETS];
+  uint64_t count = 0;
+  int b;
+
+  /* A snapshot: samples keep arriving while we print */
+  for (b = 0; b < STATS_BUCKETS; b++) {
+    buckets[b] = __atomic_load_n(&histogram->buckets[b], __ATOMIC_RELAXED);
+    count += buckets[b];
+  }
+
+  fprintf(out, "%s: %llu samples", interval_names[interval], (unsigned long long)count);
+  unless (count) {
+    fprintf(out, "\n");
+    return;
+  }
+
+  fprintf(out, ", mean ");
+  stats_print_duration(out, __atomic_load_n(&histogram->sum_ns, __ATOMIC_RELAXED) / count);
+  fprintf(out, ", p50 <");
+  stats_print_duration(out, stats_percentile(buckets, count, 0.50));
+  fprintf(out, ", p99 <");
+  stats_print_duration(out, stats_percentile(buckets, count, 0.99));
+  fprintf(out, ", max ");
+  stats_print_duration(out, __atomic_load_n(&histogram->max_ns, __ATOMIC_RELAXED));
+  fprintf(out, "\n");
+
+  for (b = 0; b < STATS_BUCKETS; b++) {
+    unless (buckets[b]) continue;
+    fprintf(out, "  <");
+    stats_print_duration(out, b ? (uint64_t)1 << b : 1);
+    fprintf(out, " %10llu\n", (unsigned long long)buckets[b]);
+  }
+}
+
+/* Dump the counters and histograms. Runs on the X reader thread. */
+void
+stats_print (FILE *out)
+{
+  int win, event, i;
+
+  fprintf(out, "Zone events:\n");
+  for (win = 0; win < monitor_count * zones_per_monitor; win++) {
+    unless (window_options[win].enabled) continue;
+    for (event = 0; event < EVENT_COUNT; event++) {
+      unless (window_options[win].counts[event]) continue;
+      fprintf(out, "  %s-%s %s: %u\n", monitors[win / zones_per_monitor].name, zone_name(win),
+              event_names[event], window_options[win].counts[event]);
+    }
+  }
+
+  fprintf(out, "Bindings by event:\n");
+  for (event = 0; event < EVENT_COUNT; event++) {
+    uint64_t row[STATS_COUNTERS];
+    uint64_t any = 0;
+
+    for (i = 0; i < STATS_COUNTERS; i++) any |= row[i] = __atomic_load_n(&counters[i][event], __ATOMIC_RELAXED);
+    unless (any) continue;
+
+    fprintf(out, "  %s:", event_names[event]);
+    for (i = 0; i < STATS_COUNTERS; i++) {
+      fprintf(out, "%s %s %llu", i ? "," : "", counter_names[i], (unsigned long long)row[i]);
+    }
+    fprintf(out, "\n");
+  }
+
+  for (i = 0; i < STATS_INTERVALS; i++) stats_print_histogram(out, i);
+  if (xtime_skewed) {
+    fprintf(out, "X server clock is not ours: %llu events not timed\n",
+            (unsigned long long)__atomic_load_n(&xtime_skewed, __ATOMIC_RELAXED));
+  }
+  fflush(out);
+}
@@ -0,0 +1,288 @@
+/**************************************************************************
+*
+* fittsmon : map mouse button events on screen corners to commands.
+*             Trace-event output of the event pipeline.
+*
+* Copyright (C) 2009 Yasen Atanasov (yasen.atanasov@gmail.com)
+* Modified 2025 by Eric Bakker (linuxbirdtweets@duck.com)
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License version 2
+* as published by the Free Software Foundation.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+**************************************************************************/
+
+/*
+ * --trace FILE writes a span for every stage an event goes through, in
+ * the Chrome trace-event JSON format Perfetto and chrome://tracing load:
+ *
+ *   receive      handling one X event, on the X reader's row
+ *   zone lookup  window (or pointer position) to zone
+ *   throttle     Coalesce and Rate deciding whether it launches
+ *   spawn        posix_spawn, on the launcher's row
+ *   command      the child from spawn to being reaped, a row per pid
+ *   validate     tokenizing and is_safe_command, once per command when
+ *                fittsmonrc is read
+ *
+ * Spans carry the zone, monitor and event. Recording one is two clock
+ * reads and a store into a ring of fixed-size entries, one ring for each
+ * of the two threads, with no lock and no formatting. The X reader turns
+ * them into JSON before it sleeps, once the batch of events is handled,
+ * where zone and monitor names can be looked up safely. The launcher
+ * pokes it through an eventfd when it has left spans behind. A full ring
+ * drops spans and counts them.
+ *
+ * The closing bracket of the JSON array is never written, which the
+ * format allows, so a trace cut short by a kill still loads.
+ */
+
+
+/* INCLUDES */
+
+#include "fittsmon.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+
+/* CONSTANTS/OPTIONS */
+
+/* Spans per thread, must be a power of two */
+#define TRACE_RING_SIZE 4096
+#define TRACE_RING_MASK (TRACE_RING_SIZE - 1)
+
+/* Rows of the trace viewer */
+#define TRACE_TID_READER   1
+#define TRACE_TID_LAUNCHER 2
+
+/* STRUCTS */
+
+struct str_span {
+  long long start;    /* CLOCK_MONOTONIC ns */
+  long long end;
+  int stage;
+  int win;            /* zone, -1 for none */
+  int event;          /* -1 for none */
+  int detail;         /* per stage: X event type, throttle result, pid, command index */
+};
+
+struct str_trace_ring {
+  struct str_span spans[TRACE_RING_SIZE];
+  uint32_t head;      /* written by the producing thread only */
+  uint32_t tail;      /* written by the X reader only */
+  uint32_t woken;     /* head when the reader was last poked */
+  uint64_t dropped;
+};
+
+/* GLOBALS */
+
+int tracing = 0;
+
+static FILE *trace_file = NULL;
+static pthread_t trace_reader;
+static struct str_trace_ring rings[2];   /* X reader, launcher */
+static int trace_wake_fd = -1;
+static long long trace_origin;
+static uint64_t trace_written = 0;
+
+static const char *stage_names[TRACE_STAGES] = {
+  "receive", "zone lookup", "throttle", "spawn", "command", "validate"
+};
+
+static const char *throttle_names[] = { "passed", "rate limited", "coalesced", "held for Coalesce" };
+
+/* implementations */
+
+/* Open the trace. Called before any other thread starts. Returns -1 on
+   failure. */
+int
+trace_start (const char *path)
+{
+  unless ((trace_file = fopen(path, "w"))) {
+    fprintf(stderr, "Cannot trace to %s: %s\n", path, strerror(errno));
+    return -1;
+  }
+
+  trace_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (trace_wake_fd < 0) perror("eventfd");
+
+  trace_reader = pthread_self();
+  trace_origin = stats_now_ns();
+
+  fprintf(trace_file, "[\n");
+  fprintf(trace_file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"fittsmon\"}},\n",
+          (int)getpid());
+  fprintf(trace_file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"X reader\"}},\n",
+          (int)getpid(), TRACE_TID_READER);
+  fprintf(trace_file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"launcher\"}},\n",
+          (int)getpid(), TRACE_TID_LAUNCHER);
+  fflush(trace_file);
+
+  tracing = 1;
+  printf("Tracing to %s\n", path);
+  return 0;
+}
+
+/* Record a span from start to now, on the ring of the calling thread */
+void
+trace_add (int stage, long long start, int win, int event, int detail)
+{
+  struct str_trace_ring *ring = &rings[pthread_equal(pthread_self(), trace_reader) ? 0 : 1];
+  uint32_t head = ring->head;
+  struct str_span *span;
+
+  if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == TRACE_RING_SIZE) {
+    __atomic_add_fetch(&ring->dropped, 1, __ATOMIC_RELAXED);
+    return;
+  }
+
+  span = &ring->spans[head & TRACE_RING_MASK];
+  span->start = start;
+  span->end = stats_now_ns();
+  span->stage = stage;
+  span->win = win;
+  span->event = event;
+  span->detail = detail;
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/* Launcher side: have the X reader write out what was left in the ring */
+void
+trace_wake (void)
+{
+  struct str_trace_ring *ring = &rings[1];
+  uint32_t head = ring->head;
+  uint64_t one = 1;
+
+  unless (tracing && trace_wake_fd >= 0 && head != ring->woken) return;
+
+  ring->woken = head;
+  if (write(trace_wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) perror("trace wakeup");
+}
+
+/* A JSON string; names come from RandR and fittsmonrc */
+static void
+trace_string (const char *text)
+{
+  fputc('"', trace_file);
+  for (; *text; text++) {
+    if (*text == '"' || *text == '\\') fprintf(trace_file, "\\%c", *text);
+    else if ((unsigned char)*text < 0x20) fprintf(trace_file, "\\u%04x", *text);
+    else fputc(*text, trace_file);
+  }
+  fputc('"', trace_file);
+}
+
+static void
+trace_write (const struct str_span *span, int tid)
+{
+  FILE *out = trace_file;
+
+  if (span->stage == TRACE_COMMAND) {
+    tid = span->detail;
+    fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"command %d\"}},\n",
+            (int)getpid(), tid, tid);
+  }
+
+  fprintf(out, "{\"name\":\"%s\",\"cat\":\"fittsmon\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d,"
+          "\"args\":{", stage_names[span->stage], (span->start - trace_origin) / 1e3,
+          (span->end - span->start) / 1e3, (int)getpid(), tid);
+
+  if (span->win >= 0 && span->win < zones_per_monitor * monitor_count) {
+    fprintf(out, "\"zone\":");
+    trace_string(zone_name(span->win));
+    fprintf(out, ",\"monitor\":");
+    trace_string(monitors[span->win / zones_per_monitor].name);
+    fputc(',', out);
+  }
+  if (span->event >= 0 && span->event < EVENT_COUNT) fprintf(out, "\"event\":\"%s\",", event_names[span->event]);
+
+  switch (span->stage) {
+  case TRACE_RECEIVE:
+    fprintf(out, "\"x_event\":\"%s\"", span->detail == XCB_BUTTON_PRESS ? "ButtonPress" :
+            span->detail == XCB_ENTER_NOTIFY ? "EnterNotify" : "LeaveNotify");
+    break;
+  case TRACE_THROTTLE:
+    fprintf(out, "\"result\":\"%s\"", throttle_names[span->detail]);
+    break;
+  case TRACE_SPAWN:
+    if (span->detail > 0) fprintf(out, "\"pid\":%d", span->detail);
+    else fprintf(out, "\"result\":\"%s\"", span->detail == 0 ? "dry run" : "failed");
+    break;
+  case TRACE_COMMAND:
+    fprintf(out, "\"pid\":%d", span->detail);
+    break;
+  case TRACE_VALIDATE:
+    fprintf(out, "\"command\":%d", span->detail);
+    break;
+  default:
+    fprintf(out, "\"found\":%s", span->win >= 0 ? "true" : "false");
+    break;
+  }
+  fprintf(out, "}},\n");
+}
+
+/* X reader side: write out the spans of both threads. Called before the
+   event loop sleeps, and before zones or monitors change under them. */
+void
+trace_flush (void)
+{
+  uint64_t wakeups;
+  int any = 0;
+
+  unless (tracing) return;
+
+  if (trace_wake_fd >= 0 && read(trace_wake_fd, &wakeups, sizeof(wakeups)) < 0 && errno != EAGAIN) {
+    perror("trace wakeup");
+  }
+
+  for (int r = 0; r < 2; r++) {
+    struct str_trace_ring *ring = &rings[r];
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint32_t tail = ring->tail;
+
+    for (; tail != head; tail++) {
+      trace_write(&ring->spans[tail & TRACE_RING_MASK], r ? TRACE_TID_LAUNCHER : TRACE_TID_READER);
+      trace_written++;
+      any = 1;
+    }
+    __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+  }
+
+  if (any) fflush(trace_file);
+}
+
+/* The eventfd the launcher pokes, -1 without tracing */
+int
+trace_watch_fd (void)
+{
+  return tracing ? trace_wake_fd : -1;
+}
+
+void
+trace_handle (int fd, uint32_t events)
+{
+  trace_flush();
+}
+
+void
+trace_print_stats (FILE *out)
+{
+  unless (tracing) return;
+
+  fprintf(out, "Trace: %llu spans written, %llu dropped\n", (unsigned long long)trace_written,
+          (unsigned long long)(__atomic_load_n(&rings[0].dropped, __ATOMIC_RELAXED) +
+                               __atomic_load_n(&rings[1].dropped, __ATOMIC_RELAXED)));
+  fflush(out);
+}